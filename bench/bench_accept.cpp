@@ -0,0 +1,56 @@
+#include "file/socket.h"
+#include "io_context.h"
+
+#include <chrono>
+#include <latch>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr int NR_CLIENTS = 64;
+constexpr int NR_CONNECTIONS = 2000;
+
+// the server closes every connection right away, clients connect, wait for EOF and connect again
+void bench(const char* name, int port, bool multishot) {
+    auto addr = *AddressResolver().host("127.0.0.1").port(port).resolve_one();
+    std::latch listening(1);
+    IOContext::spawn([&]() {
+        auto listener = socket_listen(addr, SOMAXCONN);
+        if (multishot) {
+            listener.enableMultishot();
+        }
+        listening.count_down();
+        while (true) {
+            auto sock = socket_accept(listener);
+        }
+    });
+    listening.wait();
+
+    std::latch finish(NR_CLIENTS);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < NR_CLIENTS; i++) {
+        IOContext::spawn([&]() {
+            char buf[1];
+            for (int j = 0; j < NR_CONNECTIONS; j++) {
+                auto sock = socket_connect(addr);
+                while (socket_read(sock, buf) > 0) {
+                }
+            }
+            finish.count_down();
+        });
+    }
+    finish.wait();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    spdlog::info("{}: {:.0f} connections/s", name, NR_CLIENTS * NR_CONNECTIONS / elapsed.count());
+}
+
+int main() {
+    IOContext context;
+    context.execute();
+
+    bench("accept", 8083, false);
+    bench("multishot accept", 8084, true);
+
+    context.stop();
+}
@@ -0,0 +1,128 @@
+#include "file/socket.h"
+#include "io_context.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr std::size_t MESSAGE_SIZE = 64;
+constexpr int NR_REQUESTS = 20000;
+
+void serve(SocketListener& listener) {
+    while (true) {
+        auto shared = std::make_shared<SocketHandle>(socket_accept(listener));
+        IOContext::spawn([shared]() {
+            char buf[MESSAGE_SIZE];
+            while (true) {
+                auto ret = socket_read(*shared, buf);
+                if (ret <= 0) {
+                    break;
+                }
+                socket_write(*shared, std::span(buf, static_cast<std::size_t>(ret)));
+            }
+            file_close(std::move(*shared));
+        });
+    }
+}
+
+// ping-pong round trips of NR_REQUESTS messages on each connection, the latencies are in nanoseconds
+void bench(uint32_t busy_poll_us, int nr_connections) {
+    IOContext context(IOContext::Options{.thread_count = 2, .busy_poll_us = busy_poll_us});
+    context.execute();
+
+    auto addr = *AddressResolver().host("127.0.0.1").port(8091).resolve_one();
+    std::latch listening(1);
+    IOContext::spawn([&]() {
+        auto listener = socket_listen(addr, SOMAXCONN);
+        listening.count_down();
+        serve(listener);
+    });
+    listening.wait();
+
+    std::mutex mutex;
+    std::vector<int64_t> latencies;
+    std::latch finish(nr_connections);
+    for (int i = 0; i < nr_connections; i++) {
+        IOContext::spawn([&]() {
+            std::vector<int64_t> local;
+            local.reserve(NR_REQUESTS);
+            auto sock = socket_connect(addr);
+            char buf[MESSAGE_SIZE] = {};
+            for (int j = 0; j < NR_REQUESTS; j++) {
+                auto start = std::chrono::steady_clock::now();
+                socket_write(sock, buf);
+                for (std::size_t n = 0; n < MESSAGE_SIZE;) {
+                    n += static_cast<std::size_t>(socket_read(sock, std::span(buf + n, MESSAGE_SIZE - n)));
+                }
+                local.push_back((std::chrono::steady_clock::now() - start).count());
+            }
+            file_close(std::move(sock));
+            std::lock_guard<std::mutex> lock(mutex);
+            latencies.insert(latencies.end(), local.begin(), local.end());
+            finish.count_down();
+        });
+    }
+    finish.wait();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return static_cast<double>(latencies[static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1))]) /
+               1e3;
+    };
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    for (auto const& stats : context.getSpinStats()) {
+        hits += stats.hits;
+        misses += stats.misses;
+    }
+    spdlog::info("busy poll {:>3} us, {:>2} connections: p50 {:7.1f} us, p90 {:7.1f} us, p99 {:7.1f} us, "
+                 "p99.9 {:7.1f} us, spin hits {} misses {}",
+                 busy_poll_us, nr_connections, percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999),
+                 hits, misses);
+
+    // power of 2 buckets in microseconds
+    std::vector<std::size_t> buckets;
+    for (auto latency : latencies) {
+        auto bucket = static_cast<std::size_t>(std::bit_width(static_cast<uint64_t>(latency / 1000)));
+        buckets.resize(std::max(buckets.size(), bucket + 1));
+        ++buckets[bucket];
+    }
+    for (std::size_t i = 0; i < buckets.size(); i++) {
+        spdlog::info("    < {:>6} us: {:>7}", uint64_t{1} << i, buckets[i]);
+    }
+    context.stop();
+}
+
+// bench_busy_poll [busy_poll_us nr_connections], without arguments every configuration runs in a child process
+// since there is one IOContext per process
+int main(int argc, char** argv) {
+    if (argc == 3) {
+        bench(static_cast<uint32_t>(std::stoul(argv[1])), std::stoi(argv[2]));
+        return 0;
+    }
+    for (int nr_connections : {1, 8}) {
+        for (uint32_t busy_poll_us : {0U, 20U, 50U, 200U}) {
+            auto poll_arg = std::to_string(busy_poll_us);
+            auto connections_arg = std::to_string(nr_connections);
+            char* args[] = {argv[0], poll_arg.data(), connections_arg.data(), nullptr};
+            pid_t pid{};
+            if (posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, args, environ) != 0) {
+                spdlog::error("posix_spawn failed");
+                return 1;
+            }
+            waitpid(pid, nullptr, 0);
+        }
+    }
+}
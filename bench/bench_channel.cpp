@@ -0,0 +1,86 @@
+#include "io_context.h"
+#include "synchronization/channel.h"
+#include "synchronization/wait_group.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr int NR_STAGES = 4;
+constexpr int WORKERS_PER_STAGE = 2;
+constexpr uint64_t NR_ITEMS = 500000;
+
+// A request pipeline: a producer feeds NR_STAGES stages of WORKERS_PER_STAGE fibers each, linked by channels of the
+// given capacity. Stage s runs on processor s modulo the processor count, every hop crosses processors.
+void bench(std::size_t capacity) {
+    auto nr_processors = IOContext::getInstance()->getProcessorCount();
+    std::vector<std::unique_ptr<Channel<uint64_t>>> channels;
+    for (int i = 0; i <= NR_STAGES; i++) {
+        channels.push_back(std::make_unique<Channel<uint64_t>>(capacity));
+    }
+
+    WaitGroup group;
+    uint64_t sum = 0;
+    auto begin = std::chrono::steady_clock::now();
+    group.add(1 + NR_STAGES * WORKERS_PER_STAGE + 1);
+    IOContext::spawnOn(0, [&]() {
+        for (uint64_t i = 0; i < NR_ITEMS; i++) {
+            channels[0]->send(i);
+        }
+        channels[0]->close();
+        group.done();
+    });
+    for (int stage = 0; stage < NR_STAGES; stage++) {
+        auto* in = channels[static_cast<std::size_t>(stage)].get();
+        auto* out = channels[static_cast<std::size_t>(stage) + 1].get();
+        // the last worker of a stage out closes the next channel
+        auto workers = std::make_shared<std::atomic<int>>(WORKERS_PER_STAGE);
+        for (int i = 0; i < WORKERS_PER_STAGE; i++) {
+            IOContext::spawnOn(static_cast<uint64_t>(stage + 1) % nr_processors, [in, out, workers, &group]() {
+                while (auto item = in->recv()) {
+                    out->send(*item + 1);
+                }
+                if (workers->fetch_sub(1) == 1) {
+                    out->close();
+                }
+                group.done();
+            });
+        }
+    }
+    IOContext::spawnOn(static_cast<uint64_t>(NR_STAGES + 1) % nr_processors, [&]() {
+        while (auto item = channels[NR_STAGES]->recv()) {
+            sum += *item;
+        }
+        group.done();
+    });
+    group.wait();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    auto expected = NR_ITEMS * (NR_ITEMS - 1) / 2 + NR_ITEMS * NR_STAGES;
+    spdlog::info("capacity {:>5}: {:6.2f} M items/s through {} stages{}", capacity,
+                 static_cast<double>(NR_ITEMS) / elapsed.count() / 1e6, NR_STAGES, sum == expected ? "" : ", MISMATCH");
+}
+
+// bench_channel [threads]
+int main(int argc, char** argv) {
+    IOContext::Options options;
+    if (argc == 2) {
+        options.thread_count = std::stoul(argv[1]);
+    }
+    IOContext context(options);
+    context.execute();
+
+    for (std::size_t capacity : {0, 1, 16, 256, 4096}) {
+        bench(capacity);
+    }
+    auto total = context.getMetrics().total();
+    spdlog::info("{} context switches, {} tasks stolen", total.context_switches, total.tasks_stolen);
+    context.stop();
+}
@@ -0,0 +1,104 @@
+#include "file/socket.h"
+#include "io_context.h"
+#include "task.h"
+#include "uring_op.h"
+
+#include <chrono>
+#include <latch>
+#include <memory>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr int NR_CONNECTIONS = 64;
+constexpr int NR_MESSAGES = 10000;
+constexpr size_t MESSAGE_SIZE = 64;
+
+void fiberHandler(SocketHandle sock) {
+    char buf[MESSAGE_SIZE];
+    while (true) {
+        auto ret = socket_read(sock, buf);
+        if (ret <= 0) {
+            break;
+        }
+        socket_write(sock, std::span(buf, static_cast<size_t>(ret)));
+    }
+    file_close(std::move(sock));
+}
+
+// spawned on the owner of sock, a task never leaves its processor
+Task<> taskHandler(SocketHandle sock) {
+    auto fd = sock.uringFd();
+    char buf[MESSAGE_SIZE];
+    while (true) {
+        int ret = co_await UringOp().prep_recv(fd.fd_, buf, sizeof(buf), 0).fixed_file(fd.fixed_);
+        if (ret <= 0) {
+            break;
+        }
+        co_await UringOp().prep_send(fd.fd_, buf, static_cast<size_t>(ret), 0).fixed_file(fd.fixed_);
+    }
+    if (sock.isFixed()) {
+        co_await UringOp().prep_close_direct(static_cast<unsigned int>(sock.releaseFixed()));
+    } else {
+        co_await UringOp().prep_close(sock.releaseFile());
+    }
+}
+
+void serve(SocketListener& listener, bool stackless) {
+    while (true) {
+        auto sock = socket_accept(listener);
+        if (stackless) {
+            if (sock.isFixed()) {
+                Processor::switchTo(sock.owner());
+            }
+            IOContext::spawn(taskHandler(std::move(sock)));
+        } else {
+            // std::function needs a copyable callable
+            auto shared = std::make_shared<SocketHandle>(std::move(sock));
+            IOContext::spawn([shared]() { fiberHandler(std::move(*shared)); });
+        }
+    }
+}
+
+void bench(const char* name, int port, bool stackless) {
+    auto addr = *AddressResolver().host("127.0.0.1").port(port).resolve_one();
+    std::latch listening(1);
+    IOContext::spawn([&]() {
+        auto listener = socket_listen(addr, SOMAXCONN);
+        listening.count_down();
+        serve(listener, stackless);
+    });
+    listening.wait();
+
+    std::latch finish(NR_CONNECTIONS);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < NR_CONNECTIONS; i++) {
+        IOContext::spawn([&]() {
+            auto sock = socket_connect(addr);
+            char buf[MESSAGE_SIZE] = {};
+            for (int j = 0; j < NR_MESSAGES; j++) {
+                socket_write(sock, buf);
+                for (size_t n = 0; n < MESSAGE_SIZE;) {
+                    n += static_cast<size_t>(socket_read(sock, std::span(buf + n, MESSAGE_SIZE - n)));
+                }
+            }
+            file_close(std::move(sock));
+            finish.count_down();
+        });
+    }
+    finish.wait();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    spdlog::info("{}: {:.0f} echos/s", name, NR_CONNECTIONS * NR_MESSAGES / elapsed.count());
+}
+
+// pass any argument to run with registered files
+int main(int argc, char** /*argv*/) {
+    IOContext context(IOContext::Options{.fixed_files = argc > 1 ? 4096U : 0U});
+    context.execute();
+
+    bench("fiber handlers", 8081, false);
+    bench("stackless task handlers", 8082, true);
+
+    context.stop();
+}
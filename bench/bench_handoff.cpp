@@ -0,0 +1,70 @@
+#include "io_context.h"
+#include "synchronization/futex.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <latch>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr int NR_PAIRS = 64;
+constexpr int NR_ROUNDS = 10000;
+
+// the turn of one side of a pair, the other side waits on it
+void pass(Futex& turn, uint32_t self) {
+    while (turn.load(std::memory_order_acquire) != self) {
+        turn.wait(1 - self);
+    }
+}
+
+// Pairs of fibers ping-pong through a futex, a producer/consumer handoff. With Soft both sides of a pair have the same
+// home, a wakeup brings the other side back next to the waker and it runs from the run next slot.
+void bench(Affinity affinity) {
+    std::latch finish(NR_PAIRS * 2);
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < NR_PAIRS; i++) {
+        auto* turn = new Futex();
+        SpawnOptions options{.affinity = affinity,
+                             .processor = static_cast<uint64_t>(i) % IOContext::getInstance()->getProcessorCount()};
+        for (uint32_t self : {0U, 1U}) {
+            IOContext::spawn(
+                [turn, self, &finish]() {
+                    for (int round = 0; round < NR_ROUNDS; round++) {
+                        pass(*turn, self);
+                        turn->store(1 - self, std::memory_order_release);
+                        turn->notify_one();
+                    }
+                    if (self == 1) {
+                        delete turn;
+                    }
+                    finish.count_down();
+                },
+                options);
+        }
+    }
+    finish.wait();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+    spdlog::info("{:>4}: {:8.1f} ns per handoff", affinity == Affinity::Soft ? "soft" : "none",
+                 elapsed.count() / (NR_PAIRS * NR_ROUNDS * 2.0));
+}
+
+// bench_handoff [threads]
+int main(int argc, char** argv) {
+    IOContext::Options options;
+    if (argc == 2) {
+        options.thread_count = std::stoul(argv[1]);
+    }
+    IOContext context(options);
+    context.execute();
+
+    for (auto affinity : {Affinity::None, Affinity::Soft}) {
+        bench(affinity);
+    }
+    auto total = context.getMetrics().total();
+    spdlog::info("{} context switches, {} tasks stolen", total.context_switches, total.tasks_stolen);
+    context.stop();
+}
@@ -0,0 +1,109 @@
+#include "file/socket.h"
+#include "http/server.h"
+#include "io_context.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <latch>
+#include <string>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr auto DURATION = std::chrono::seconds(5);
+constexpr int NR_CONNECTIONS = 64;
+
+constexpr std::string_view REQUEST = "GET / HTTP/1.1\r\n"
+                                     "Host: 127.0.0.1\r\n"
+                                     "User-Agent: bench_http\r\n"
+                                     "Accept: */*\r\n"
+                                     "\r\n";
+
+// the http module writes exactly the same bytes for the handler below
+constexpr std::string_view RESPONSE = "HTTP/1.1 200 OK\r\n"
+                                      "Content-Type: text/html\r\n"
+                                      "Content-Length: 13\r\n"
+                                      "\r\n"
+                                      "Hello, world!";
+
+// the server of tests/test_server.cpp, one response per read whatever was read
+void handleHardcoded(SocketHandle sock) {
+    char buf[256];
+    while (true) {
+        auto ret = socket_read(sock, buf);
+        if (ret <= 0) {
+            break;
+        }
+        socket_write(sock, RESPONSE);
+    }
+    file_close(std::move(sock));
+}
+
+void handleHttp(http::Request const& /*unused*/, http::ResponseWriter& writer) {
+    writer.send(200, "Hello, world!", "text/html");
+}
+
+// wrk style: every connection writes pipeline requests at once and reads all the responses, until the deadline
+void bench(std::string_view name, SocketAddress const& addr, std::size_t pipeline) {
+    std::string requests;
+    for (std::size_t i = 0; i < pipeline; i++) {
+        requests += REQUEST;
+    }
+    auto expected = pipeline * RESPONSE.size();
+
+    std::atomic<uint64_t> nr_responses{0};
+    std::latch finish(NR_CONNECTIONS);
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + DURATION;
+    for (int i = 0; i < NR_CONNECTIONS; i++) {
+        IOContext::spawn([&]() {
+            auto sock = socket_connect(addr);
+            std::string buf(expected, '\0');
+            uint64_t local = 0;
+            while (std::chrono::steady_clock::now() < deadline) {
+                socket_write(sock, requests);
+                for (std::size_t n = 0; n < expected;) {
+                    auto ret = socket_read(sock, std::span(buf.data() + n, expected - n));
+                    if (ret <= 0) {
+                        spdlog::error("{}: connection closed", name);
+                        finish.count_down();
+                        return;
+                    }
+                    n += static_cast<std::size_t>(ret);
+                }
+                local += pipeline;
+            }
+            file_close(std::move(sock));
+            nr_responses.fetch_add(local, std::memory_order_relaxed);
+            finish.count_down();
+        });
+    }
+    finish.wait();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    spdlog::info("{:>9} server, pipeline {:>2}: {:10.0f} req/s", name, pipeline,
+                 static_cast<double>(nr_responses.load()) / elapsed);
+}
+
+int main() {
+    IOContext context;
+    context.execute();
+
+    auto hardcoded_addr = *AddressResolver().host("127.0.0.1").port(8093).resolve_one();
+    auto http_addr = *AddressResolver().host("127.0.0.1").port(8094).resolve_one();
+    std::latch listening(1);
+    IOContext::spawn([&]() {
+        socket_listen_sharded(hardcoded_addr, handleHardcoded);
+        http::serve(http_addr, handleHttp);
+        listening.count_down();
+    });
+    listening.wait();
+
+    // the hardcoded server answers reads rather than requests, it can't take pipelined requests
+    bench("hardcoded", hardcoded_addr, 1);
+    bench("http", http_addr, 1);
+    bench("http", http_addr, 16);
+    context.stop();
+}
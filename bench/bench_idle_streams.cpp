@@ -0,0 +1,67 @@
+#include "io_context.h"
+#include "stream/socket_stream.h"
+#include "util.h"
+
+#include <chrono>
+#include <fstream>
+#include <latch>
+#include <memory>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+// two fds per connection, stay below the default limit of open files
+constexpr ptrdiff_t NR_CONNECTIONS = 400;
+
+double rssMiB() {
+    std::ifstream statm("/proc/self/statm");
+    double vsz{};
+    double rss{};
+    statm >> vsz >> rss;
+    return rss * static_cast<double>(sysconf(_SC_PAGESIZE)) / 1024 / 1024;
+}
+
+// every connection sends one line and then stays quiet, the server streams wait for the next one
+// pass any argument to read into provided buffers
+int main(int argc, char** /*argv*/) {
+    IOContext context(IOContext::Options{.recv_buffers = argc > 1 ? 256U : 0U});
+    context.execute();
+
+    auto addr = *AddressResolver().host("127.0.0.1").port(8085).resolve_one();
+    std::latch listening(1);
+    std::latch served(NR_CONNECTIONS);
+    IOContext::spawn([&]() {
+        auto listener = socket_listen(addr, SOMAXCONN);
+        listening.count_down();
+        while (true) {
+            auto sock = std::make_shared<SocketHandle>(socket_accept(listener));
+            IOContext::spawn([&served, sock]() {
+                auto stream = make_stream<SocketStream>(std::move(*sock));
+                try {
+                    while (true) {
+                        stream.getline('\n');
+                        served.count_down();
+                    }
+                } catch (Stream::EOFException&) {
+                }
+            });
+        }
+    });
+    listening.wait();
+
+    auto rss_before = rssMiB();
+    for (ptrdiff_t i = 0; i < NR_CONNECTIONS; i++) {
+        IOContext::spawn([&]() {
+            auto sock = socket_connect(addr);
+            socket_write(sock, std::string_view("hello\n"));
+            // keep the connection open until the measurement is done
+            sleepFor(std::chrono::seconds(5));
+        });
+    }
+    served.wait();
+    spdlog::info("{} idle streams: RSS +{:.1f} MiB", NR_CONNECTIONS, rssMiB() - rss_before);
+
+    context.stop();
+}
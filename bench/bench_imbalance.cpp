@@ -0,0 +1,82 @@
+#include "io_context.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <latch>
+#include <memory>
+#include <numeric>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr int NR_BURSTS = 200;
+constexpr int BURST_SIZE = 256;
+constexpr std::size_t TASK_BYTES = 64 * 1024;
+
+// All the work is spawned on processor 0, the others only get it by stealing. Each task reads a buffer written by
+// processor 0, a thief close to it finds the data in a shared cache or at least on its NUMA node.
+void bench(bool pin_threads) {
+    IOContext context(IOContext::Options{.pin_threads = pin_threads});
+    context.execute();
+
+    std::atomic<uint64_t> checksum{0};
+    std::latch finish(1);
+    auto begin = std::chrono::steady_clock::now();
+    IOContext::spawnOn(0, [&]() {
+        std::atomic<int> done{0};
+        for (int i = 0; i < NR_BURSTS; i++) {
+            for (int j = 0; j < BURST_SIZE; j++) {
+                auto data = std::make_shared<std::vector<uint64_t>>(TASK_BYTES / sizeof(uint64_t),
+                                                                     static_cast<uint64_t>(j));
+                IOContext::spawn([data, &checksum, &done]() {
+                    checksum.fetch_add(std::accumulate(data->begin(), data->end(), uint64_t{0}),
+                                       std::memory_order_relaxed);
+                    done.fetch_add(1, std::memory_order_relaxed);
+                });
+            }
+            // let the thieves take some before the next burst
+            Fiber::yield(Fiber::READY);
+        }
+        // a latch would block the thread, and the last task of the local queue is left to us
+        while (done.load(std::memory_order_relaxed) != NR_BURSTS * BURST_SIZE) {
+            Fiber::yield(Fiber::READY);
+        }
+        finish.count_down();
+    });
+    finish.wait();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+
+    auto metrics = context.getMetrics();
+    auto total = metrics.total();
+    spdlog::info("pin_threads {}, {} nodes: {:8.1f} ms, {} steals, {} tasks stolen, {} from remote nodes", pin_threads,
+                 context.getTopology().nodeCount(), elapsed.count(), total.steal_successes, total.tasks_stolen,
+                 total.tasks_stolen_remote);
+    for (std::size_t i = 0; i < metrics.processors.size(); i++) {
+        spdlog::info("    processor {:>3}: {:>7} context switches", i, metrics.processors[i].context_switches);
+    }
+    context.stop();
+}
+
+// bench_imbalance [pin_threads], without arguments both configurations run in a child process since there is one
+// IOContext per process
+int main(int argc, char** argv) {
+    if (argc == 2) {
+        bench(std::stoi(argv[1]) != 0);
+        return 0;
+    }
+    for (std::string pin : {"0", "1"}) {
+        char* args[] = {argv[0], pin.data(), nullptr};
+        pid_t pid{};
+        if (posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, args, environ) != 0) {
+            spdlog::error("posix_spawn failed");
+            return 1;
+        }
+        waitpid(pid, nullptr, 0);
+    }
+}
@@ -0,0 +1,223 @@
+#include "common/args.h"
+#include "common/histogram.h"
+#include "common/report.h"
+#include "file/socket.h"
+#include "http/server.h"
+#include "io_context.h"
+#include "stream/socket_stream.h"
+#include "util.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <latch>
+#include <mutex>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+using namespace sylar::bench;
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+    std::string mode;
+    std::string host;
+    uint16_t port;
+    long connections;
+    long pipeline;
+    // requests per second over all the connections, 0 for a closed loop
+    double rate;
+    Clock::duration warmup;
+    Clock::duration duration;
+    std::size_t payload;
+    std::string path;
+};
+
+struct Totals {
+    std::mutex mutex;
+    Histogram latency;
+    uint64_t requests{};
+    uint64_t errors{};
+};
+
+void serveHttp(http::Request const& /*unused*/, http::ResponseWriter& writer) {
+    writer.send(200, "Hello, world!", "text/html");
+}
+
+void serveEcho(SocketHandle sock) {
+    char buf[4096];
+    while (true) {
+        auto ret = socket_read(sock, buf);
+        if (ret <= 0) {
+            break;
+        }
+        socket_write(sock, std::span(buf, static_cast<std::size_t>(ret)));
+    }
+    file_close(std::move(sock));
+}
+
+// read a response head and skip its body, false if the status isn't 200
+bool readHttpResponse(BorrowedStream& stream, std::string& line) {
+    line.clear();
+    stream.getline(line, '\n');
+    bool ok = line.starts_with("HTTP/1.1 200") || line.starts_with("HTTP/1.0 200");
+    std::size_t content_length = 0;
+    while (true) {
+        line.clear();
+        stream.getline(line, '\n');
+        if (line == "\r" || line.empty()) {
+            break;
+        }
+        auto colon = line.find(':');
+        if (colon != std::string::npos && http::equalsIgnoreCase(line.substr(0, colon), "Content-Length")) {
+            content_length = std::stoul(line.substr(colon + 1));
+        }
+    }
+    stream.ingore(content_length);
+    return ok;
+}
+
+// One fiber per connection. In the open loop the requests are sent on a fixed schedule and the latency is measured
+// from the time a request was due rather than sent, so a stalled server isn't hidden by the client waiting on it.
+// The schedule has the granularity of the timer wheel, a faster rate per connection goes out in bursts.
+void runConnection(Config const& config, SocketAddress const& addr, Clock::time_point start, Totals& totals) {
+    Histogram latency;
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    auto measure_from = start + config.warmup;
+    auto end = measure_from + config.duration;
+
+    std::string request;
+    if (config.mode == "http") {
+        request = fmt::format("GET {} HTTP/1.1\r\nHost: {}\r\nUser-Agent: bench_loadgen\r\n\r\n", config.path,
+                              config.host);
+    } else {
+        request.assign(config.payload, 'x');
+    }
+    std::string requests_out;
+    for (long i = 0; i < config.pipeline; i++) {
+        requests_out += request;
+    }
+    std::string line;
+    std::string echo(request.size(), '\0');
+
+    auto interval = config.rate > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(
+                                          static_cast<double>(config.connections * config.pipeline) / config.rate))
+                                    : Clock::duration::zero();
+    auto due = start;
+    try {
+        auto stream = make_stream<SocketStream>(socket_connect(addr));
+        while (true) {
+            auto now = Clock::now();
+            if (now >= end) {
+                break;
+            }
+            if (config.rate > 0) {
+                if (due > now) {
+                    sleepFor(due - now);
+                }
+            } else {
+                due = now;
+            }
+
+            stream.put(requests_out);
+            stream.flush();
+            for (long i = 0; i < config.pipeline; i++) {
+                bool ok = true;
+                if (config.mode == "http") {
+                    ok = readHttpResponse(stream, line);
+                } else {
+                    stream.get(echo);
+                }
+                if (due < measure_from) {
+                    continue;
+                }
+                if (!ok) {
+                    errors++;
+                }
+                requests++;
+                latency.record((Clock::now() - due).count());
+            }
+            due += interval;
+        }
+    } catch (std::exception& ex) {
+        spdlog::warn("connection: {}", ex.what());
+        errors++;
+    }
+
+    std::lock_guard<std::mutex> lock(totals.mutex);
+    totals.latency.merge(latency);
+    totals.requests += requests;
+    totals.errors += errors;
+}
+
+// bench_loadgen [--mode http|tcp] [--host 127.0.0.1] [--port 8080] [--connections 64] [--pipeline 1]
+//               [--rate requests/s, 0 for a closed loop] [--warmup 1] [--duration 10] [--payload 64] [--path /]
+//               [--threads n] [--self] [--json path]
+// --self serves the requests in process, with sylar::http or a TCP echo server
+int main(int argc, char** argv) {
+    Args args(argc, argv);
+    Config config{
+        .mode = args.get("mode", std::string("http")),
+        .host = args.get("host", std::string("127.0.0.1")),
+        .port = static_cast<uint16_t>(args.getInt("port", 8080)),
+        .connections = args.getInt("connections", 64),
+        .pipeline = std::max(args.getInt("pipeline", 1), 1L),
+        .rate = args.getDouble("rate", 0),
+        .warmup =
+            std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(args.getDouble("warmup", 1))),
+        .duration =
+            std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(args.getDouble("duration", 10))),
+        .payload = static_cast<std::size_t>(args.getInt("payload", 64)),
+        .path = args.get("path", std::string("/")),
+    };
+    if (config.mode != "http" && config.mode != "tcp") {
+        spdlog::error("unknown mode {}", config.mode);
+        return 1;
+    }
+
+    IOContext::Options options;
+    if (args.has("threads")) {
+        options.thread_count = static_cast<std::size_t>(args.getInt("threads", 0));
+    }
+    IOContext context(options);
+    context.execute();
+
+    auto addr = *AddressResolver().host(config.host).port(config.port).resolve_one();
+    if (args.has("self")) {
+        std::latch listening(1);
+        IOContext::spawn([&]() {
+            if (config.mode == "http") {
+                http::serve(addr, serveHttp);
+            } else {
+                socket_listen_sharded(addr, serveEcho);
+            }
+            listening.count_down();
+        });
+        listening.wait();
+    }
+
+    Totals totals;
+    std::latch finish(config.connections);
+    auto start = Clock::now();
+    for (long i = 0; i < config.connections; i++) {
+        IOContext::spawn([&]() {
+            runConnection(config, addr, start, totals);
+            finish.count_down();
+        });
+    }
+    finish.wait();
+    context.stop();
+
+    Report report("loadgen");
+    auto name = fmt::format("{}_c{}_p{}_{}", config.mode, config.connections, config.pipeline,
+                            config.rate > 0 ? fmt::format("rate{:.0f}", config.rate) : std::string("closed"));
+    report.add(name)
+        .set("requests", static_cast<double>(totals.requests))
+        .set("errors", static_cast<double>(totals.errors))
+        .set("req_per_s", static_cast<double>(totals.requests) /
+                              std::chrono::duration<double>(config.duration).count())
+        .setLatency(totals.latency);
+    report.write(args.get("json", std::string()));
+}
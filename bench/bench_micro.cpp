@@ -0,0 +1,187 @@
+#include "common/args.h"
+#include "common/report.h"
+#include "detail/timer.h"
+#include "io_context.h"
+#include "stream/stream.h"
+#include "synchronization/mutex.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <latch>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+using namespace sylar::bench;
+using Clock = std::chrono::steady_clock;
+
+constexpr int NR_REPS = 5;
+
+// run bench NR_REPS times after a warmup run, bench returns the number of operations it ran
+template <class Bench>
+void measure(Report& report, std::string name, Bench&& bench) {
+    bench();
+    std::vector<double> ns_per_op;
+    for (int i = 0; i < NR_REPS; i++) {
+        auto begin = Clock::now();
+        auto ops = bench();
+        ns_per_op.push_back(std::chrono::duration<double, std::nano>(Clock::now() - begin).count() /
+                            static_cast<double>(ops));
+    }
+    std::sort(ns_per_op.begin(), ns_per_op.end());
+    report.add(std::move(name))
+        .set("ns_per_op", ns_per_op[ns_per_op.size() / 2])
+        .set("ns_per_op_min", ns_per_op.front())
+        .set("ns_per_op_max", ns_per_op.back());
+}
+
+// two fibers pinned to processor 0 yielding to each other
+uint64_t benchFiberSwitch() {
+    constexpr int NR_YIELDS = 500000;
+    std::latch finish(2);
+    for (int i = 0; i < 2; i++) {
+        IOContext::spawnOn(0, [&]() {
+            for (int j = 0; j < NR_YIELDS; j++) {
+                Fiber::yield(Fiber::READY);
+            }
+            finish.count_down();
+        });
+    }
+    finish.wait();
+    return 2 * NR_YIELDS;
+}
+
+// spawn empty fibers from a fiber until they all ran, the stacks come from the free list after the warmup
+uint64_t benchSpawn() {
+    constexpr int NR_FIBERS = 100000;
+    std::atomic<int> done{0};
+    std::latch finish(1);
+    IOContext::spawn([&]() {
+        for (int i = 0; i < NR_FIBERS; i++) {
+            IOContext::spawn([&]() {
+                if (done.fetch_add(1, std::memory_order_relaxed) + 1 == NR_FIBERS) {
+                    finish.count_down();
+                }
+            });
+        }
+    });
+    finish.wait();
+    return NR_FIBERS;
+}
+
+// processor 0 spawns batches of tasks into its local queue and spins while the others steal and run them
+uint64_t benchSteal() {
+    constexpr int NR_BATCHES = 200;
+    constexpr int BATCH_SIZE = 128;
+    std::latch finish(1);
+    IOContext::spawnOn(0, [&]() {
+        for (int i = 0; i < NR_BATCHES; i++) {
+            std::atomic<int> done{0};
+            for (int j = 0; j < BATCH_SIZE; j++) {
+                IOContext::spawn([&]() { done.fetch_add(1, std::memory_order_relaxed); });
+            }
+            // the last task in a queue is left to its owner
+            while (done.load(std::memory_order_relaxed) < BATCH_SIZE - 1) {
+                cpuRelax();
+            }
+            while (done.load(std::memory_order_relaxed) != BATCH_SIZE) {
+                Fiber::yield(Fiber::READY);
+            }
+        }
+        finish.count_down();
+    });
+    finish.wait();
+    return NR_BATCHES * BATCH_SIZE;
+}
+
+class Wheel : public TimerManager {};
+
+// a timeout armed and cancelled, as the deadline of a read which completes in time
+uint64_t benchTimer() {
+    constexpr int NR_TIMERS = 1000000;
+    Wheel wheel;
+    for (int i = 0; i < NR_TIMERS; i++) {
+        wheel.addTimer(std::chrono::milliseconds(1000 + i % 1000), []() {}).cancel();
+    }
+    return NR_TIMERS;
+}
+
+// fibers on every processor incrementing a counter under one Mutex
+uint64_t benchMutex() {
+    constexpr int NR_LOCKS = 200000;
+    auto nr_fibers = static_cast<int>(IOContext::getInstance()->getProcessorCount()) * 4;
+    Mutex mutex;
+    uint64_t counter = 0;
+    std::latch finish(nr_fibers);
+    for (int i = 0; i < nr_fibers; i++) {
+        IOContext::spawn([&]() {
+            for (int j = 0; j < NR_LOCKS / nr_fibers; j++) {
+                mutex.lock();
+                counter++;
+                mutex.unlock();
+            }
+            finish.count_down();
+        });
+    }
+    finish.wait();
+    return counter;
+}
+
+// an endless stream of 64 byte lines
+class LineStream : public Stream {
+public:
+    std::size_t raw_read(std::span<char> buffer) override {
+        for (std::size_t i = 0; i < buffer.size(); i++) {
+            buffer[i] = LINE[offset_++ % LINE.size()];
+        }
+        return buffer.size();
+    }
+
+    static constexpr std::string_view LINE = "GET /index.html HTTP/1.1 Host: 127.0.0.1 Accept: */* Padding..\r\n";
+
+private:
+    std::size_t offset_{};
+};
+
+uint64_t benchGetline() {
+    constexpr int NR_LINES = 1000000;
+    auto stream = make_stream<LineStream>();
+    std::string line;
+    std::size_t bytes = 0;
+    for (int i = 0; i < NR_LINES; i++) {
+        line.clear();
+        stream.getline(line, '\n');
+        bytes += line.size();
+    }
+    assertThat(bytes == NR_LINES * (LineStream::LINE.size() - 1));
+    return NR_LINES;
+}
+
+// bench_micro [--threads n] [--json path]
+int main(int argc, char** argv) {
+    Args args(argc, argv);
+    IOContext::Options options;
+    options.thread_count = static_cast<std::size_t>(std::max(args.getInt("threads", 4), 2L));
+    IOContext context(options);
+    context.execute();
+
+    Report report("micro");
+    measure(report, "fiber_switch", benchFiberSwitch);
+    measure(report, "fiber_spawn", benchSpawn);
+    auto stolen_before = context.getMetrics().total().tasks_stolen;
+    measure(report, "fiber_steal", benchSteal);
+    report.add("fiber_steal_tasks").set("stolen", static_cast<double>(context.getMetrics().total().tasks_stolen -
+                                                                     stolen_before));
+    measure(report, "timer_add_cancel", benchTimer);
+    measure(report, "mutex_contention", benchMutex);
+    measure(report, "stream_getline", benchGetline);
+    context.stop();
+
+    report.write(args.get("json", std::string()));
+}
@@ -0,0 +1,61 @@
+#include "io_context.h"
+
+#include <algorithm>
+#include <chrono>
+#include <latch>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr int ROUNDS = 100000;
+
+// ping runs on processor 0 and pong on processor pong_id, every round trip is two posts
+std::vector<std::chrono::nanoseconds> pingpong(uint64_t pong_id) {
+    std::vector<std::chrono::nanoseconds> latencies;
+    latencies.reserve(ROUNDS);
+    std::latch finish(1);
+
+    Fiber* ping = nullptr;
+    Fiber* pong = Fiber::newFiber([&]() {
+        for (int i = 0; i < ROUNDS; i++) {
+            Processor::post(ping, 0);
+            if (i + 1 < ROUNDS) {
+                Fiber::yield();
+            }
+        }
+    });
+    ping = Fiber::newFiber([&]() {
+        for (int i = 0; i < ROUNDS; i++) {
+            auto start = std::chrono::steady_clock::now();
+            Processor::post(pong, pong_id);
+            Fiber::yield();
+            latencies.push_back(std::chrono::steady_clock::now() - start);
+        }
+        finish.count_down();
+    });
+
+    IOContext::spawn([ping]() { Processor::post(ping, 0); });
+    finish.wait();
+
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+}
+
+void report(const char* name, std::vector<std::chrono::nanoseconds> const& latencies) {
+    auto percentile = [&](double p) {
+        return latencies[static_cast<size_t>(p * static_cast<double>(latencies.size() - 1))].count();
+    };
+    spdlog::info("{}: p50 {} ns, p99 {} ns, p999 {} ns, max {} ns", name, percentile(0.5), percentile(0.99),
+                 percentile(0.999), latencies.back().count());
+}
+
+int main() {
+    IOContext context(2);
+    context.execute();
+
+    report("same processor round trip ", pingpong(0));
+    report("cross processor round trip", pingpong(1));
+    context.stop();
+}
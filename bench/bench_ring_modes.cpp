@@ -0,0 +1,102 @@
+#include "file/socket.h"
+#include "io_context.h"
+
+#include <array>
+#include <chrono>
+#include <latch>
+#include <spawn.h>
+#include <string>
+#include <string_view>
+#include <sys/wait.h>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr int NR_CONNECTIONS = 64;
+constexpr int NR_REQUESTS = 10000;
+
+constexpr std::string_view REQUEST = "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+constexpr std::string_view RESPONSE = "HTTP/1.1 200 OK\r\n"
+                                      "Content-Type: text/html\r\n"
+                                      "Content-Length: 13\r\n"
+                                      "\r\n"
+                                      "Hello, world!";
+
+constexpr std::array<std::pair<RingMode, const char*>, 3> MODES{{
+    {RingMode::Default, "default"},
+    {RingMode::DeferTaskrun, "defer_taskrun"},
+    {RingMode::SqPoll, "sqpoll"},
+}};
+
+// the handler of test_server
+void handle(SocketHandle sock) {
+    char buf[256];
+    while (true) {
+        auto ret = socket_read(sock, buf);
+        if (ret <= 0) {
+            break;
+        }
+        socket_write(sock, RESPONSE);
+    }
+    file_close(std::move(sock));
+}
+
+void bench(std::size_t mode, bool fixed_files) {
+    IOContext context(IOContext::Options{.ring_mode = MODES[mode].first, .fixed_files = fixed_files ? 4096U : 0U});
+    context.execute();
+
+    auto addr = *AddressResolver().host("127.0.0.1").port(8090).resolve_one();
+    std::latch listening(1);
+    IOContext::spawn([&]() {
+        socket_listen_sharded(addr, handle);
+        listening.count_down();
+    });
+    listening.wait();
+
+    std::latch finish(NR_CONNECTIONS);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < NR_CONNECTIONS; i++) {
+        IOContext::spawn([&]() {
+            auto sock = socket_connect(addr);
+            char buf[256];
+            for (int j = 0; j < NR_REQUESTS; j++) {
+                socket_write(sock, REQUEST);
+                for (std::size_t n = 0; n < RESPONSE.size();) {
+                    n += static_cast<std::size_t>(socket_read(sock, std::span(buf, sizeof(buf))));
+                }
+            }
+            file_close(std::move(sock));
+            finish.count_down();
+        });
+    }
+    finish.wait();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    auto stats = context.getSubmitStats();
+    spdlog::info("{:<13} {:<11}: {:9.0f} requests/s, {:5.1f} SQEs/submit", MODES[mode].second,
+                 fixed_files ? "fixed files" : "plain fds", NR_CONNECTIONS * NR_REQUESTS / elapsed.count(),
+                 stats.sqesPerSubmit());
+    context.stop();
+}
+
+// bench_ring_modes [mode fixed_files], without arguments every configuration runs in a child process since there
+// is one IOContext per process
+int main(int argc, char** argv) {
+    if (argc == 3) {
+        bench(std::stoul(argv[1]), std::stoi(argv[2]) != 0);
+        return 0;
+    }
+    for (std::size_t mode = 0; mode < MODES.size(); mode++) {
+        for (int fixed_files : {0, 1}) {
+            auto mode_arg = std::to_string(mode);
+            auto fixed_arg = std::to_string(fixed_files);
+            char* args[] = {argv[0], mode_arg.data(), fixed_arg.data(), nullptr};
+            pid_t pid{};
+            if (posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, args, environ) != 0) {
+                spdlog::error("posix_spawn failed");
+                return 1;
+            }
+            waitpid(pid, nullptr, 0);
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#include "runqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <latch>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+// the mutex guarded run queue, as it was before the lock-free one
+class LockedRunQueue {
+public:
+    using Task = Fiber*;
+
+    bool emplace(Task task) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.size() >= RunQueue::CAPACITY) {
+            return false;
+        }
+        tasks_.push(task);
+        return true;
+    }
+
+    size_t steal(LockedRunQueue& rq, bool stealRunNext) {
+        std::scoped_lock lock(mutex_, rq.mutex_);
+        if (tasks_.empty()) {
+            return 0;
+        }
+        if (tasks_.size() == 1 && !stealRunNext) {
+            return 0;
+        }
+
+        auto len = (tasks_.size() + 1) / 2;
+        for (size_t i = 0; i < len; i++) {
+            rq.tasks_.push(tasks_.front());
+            tasks_.pop();
+        }
+        return len;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return tasks_.size();
+    }
+
+    Task pop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) {
+            return nullptr;
+        }
+        Task task = tasks_.front();
+        tasks_.pop();
+        return task;
+    }
+
+private:
+    std::mutex mutex_;
+    std::queue<Task> tasks_;
+};
+
+constexpr int ROUNDS = 200000;
+constexpr uintptr_t BATCH = 32;
+
+// every processor pushes a batch, runs half of it, and then steals from a random victim like Processor::execute
+template <class Queue>
+double run(size_t nr_p) {
+    std::vector<Queue> queues(nr_p);
+    std::atomic<uint64_t> ops{0};
+    std::latch start(static_cast<std::ptrdiff_t>(nr_p) + 1);
+    std::vector<std::thread> threads;
+
+    for (size_t id = 0; id < nr_p; id++) {
+        threads.emplace_back([&, id]() {
+            std::minstd_rand rand(static_cast<uint32_t>(id));
+            auto& rq = queues[id];
+            uint64_t local_ops = 0;
+            start.arrive_and_wait();
+            for (int round = 0; round < ROUNDS; round++) {
+                for (uintptr_t i = 1; i <= BATCH; i++) {
+                    local_ops += rq.emplace(reinterpret_cast<Fiber*>(i)) ? 1 : 0;
+                }
+                for (uintptr_t i = 0; i < BATCH / 2; i++) {
+                    local_ops += rq.pop() != nullptr ? 1 : 0;
+                }
+                rq.size();
+                if (nr_p > 1) {
+                    auto victim = rand() % nr_p;
+                    if (victim != id) {
+                        local_ops += queues[victim].steal(rq, false);
+                    }
+                }
+                while (rq.size() > BATCH) {
+                    local_ops += rq.pop() != nullptr ? 1 : 0;
+                }
+            }
+            ops.fetch_add(local_ops, std::memory_order_relaxed);
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start.arrive_and_wait();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return static_cast<double>(ops.load()) / elapsed.count() / 1e6;
+}
+
+int main() {
+    for (size_t nr_p : {1, 4, 16}) {
+        auto locked = run<LockedRunQueue>(nr_p);
+        auto lockfree = run<RunQueue>(nr_p);
+        spdlog::info("{:>2} processors: mutex {:8.2f} Mops/s, lock-free {:8.2f} Mops/s", nr_p, locked, lockfree);
+    }
+}
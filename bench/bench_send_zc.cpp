@@ -0,0 +1,59 @@
+#include "file/socket.h"
+#include "io_context.h"
+
+#include <chrono>
+#include <latch>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr std::size_t TOTAL_SIZE = std::size_t{4} << 30;
+
+// stream TOTAL_SIZE bytes over loopback in chunks of chunk_size, the receiver drains them into a 1 MiB buffer.
+// Loopback delivers zero-copy skbs by copying them on the receive side, the send side still skips its copy.
+void bench(const char* name, int port, std::size_t chunk_size, bool zerocopy) {
+    auto addr = *AddressResolver().host("127.0.0.1").port(port).resolve_one();
+    std::latch listening(1);
+    std::latch finish(1);
+    IOContext::spawn([&]() {
+        auto listener = socket_listen(addr, SOMAXCONN);
+        listening.count_down();
+        auto sock = socket_accept(listener);
+        std::vector<char> buf(1 << 20);
+        for (std::size_t received = 0; received < TOTAL_SIZE;) {
+            received += static_cast<std::size_t>(socket_read(sock, buf));
+        }
+        finish.count_down();
+    });
+    listening.wait();
+
+    auto start = std::chrono::steady_clock::now();
+    IOContext::spawn([&]() {
+        auto sock = socket_connect(addr);
+        std::vector<char> chunk(chunk_size, 'x');
+        for (std::size_t sent = 0; sent < TOTAL_SIZE;) {
+            auto len = std::min(chunk_size, TOTAL_SIZE - sent);
+            auto buf = std::span<char const>(chunk.data(), len);
+            sent += static_cast<std::size_t>(zerocopy ? socket_send_zc(sock, buf) : socket_write(sock, buf));
+        }
+    });
+    finish.wait();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    spdlog::info("{} {:>5} KiB chunks: {:.2f} GiB/s", name, chunk_size / 1024,
+                 static_cast<double>(TOTAL_SIZE) / elapsed.count() / (1 << 30));
+}
+
+int main() {
+    IOContext context;
+    context.execute();
+
+    int port = 8086;
+    for (std::size_t chunk_size : {std::size_t{64} << 10, std::size_t{1} << 20, std::size_t{4} << 20}) {
+        bench("write  ", port++, chunk_size, false);
+        bench("send_zc", port++, chunk_size, true);
+    }
+
+    context.stop();
+}
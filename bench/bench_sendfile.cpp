@@ -0,0 +1,99 @@
+#include "file/file.h"
+#include "file/socket.h"
+#include "io_context.h"
+
+#include <chrono>
+#include <fcntl.h>
+#include <filesystem>
+#include <latch>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr std::size_t FILE_SIZE = std::size_t{1} << 30;
+constexpr std::size_t COPY_BUFFER_SIZE = std::size_t{1} << 20;
+
+void createFile(std::filesystem::path const& path) {
+    int fd = checkRet(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+    std::vector<char> chunk(COPY_BUFFER_SIZE);
+    for (std::size_t i = 0; i < chunk.size(); i++) {
+        chunk[i] = static_cast<char>('a' + i % 26);
+    }
+    for (std::size_t written = 0; written < FILE_SIZE; written += chunk.size()) {
+        checkRet(static_cast<int>(write(fd, chunk.data(), chunk.size())));
+    }
+    close(fd);
+}
+
+// user and system CPU time of the whole process, both ends of the connection included
+double cpuSeconds() {
+    struct rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    auto seconds = [](struct timeval tv) {
+        return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+    };
+    return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+// serve the file to a client over loopback, the client drains it into a 1 MiB buffer
+void bench(const char* name, int port, std::filesystem::path const& path, bool splice) {
+    auto addr = *AddressResolver().host("127.0.0.1").port(port).resolve_one();
+    std::latch listening(1);
+    std::latch finish(1);
+    IOContext::spawn([&]() {
+        auto listener = socket_listen(addr, SOMAXCONN);
+        listening.count_down();
+        auto sock = socket_accept(listener);
+        auto file = file_open(path, OpenMode::Read);
+        if (splice) {
+            transfer(file, sock, 0, FILE_SIZE);
+        } else {
+            std::vector<char> buf(COPY_BUFFER_SIZE);
+            for (std::size_t sent = 0; sent < FILE_SIZE;) {
+                auto n = file_read(file, buf, sent);
+                for (int written = 0; written < n;) {
+                    written += socket_write(sock, std::span<char const>(buf.data() + written, buf.data() + n));
+                }
+                sent += static_cast<std::size_t>(n);
+            }
+        }
+    });
+    listening.wait();
+
+    auto start = std::chrono::steady_clock::now();
+    auto cpu_start = cpuSeconds();
+    IOContext::spawn([&]() {
+        auto sock = socket_connect(addr);
+        std::vector<char> buf(COPY_BUFFER_SIZE);
+        for (std::size_t received = 0; received < FILE_SIZE;) {
+            received += static_cast<std::size_t>(socket_read(sock, buf));
+        }
+        finish.count_down();
+    });
+    finish.wait();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    auto gib = static_cast<double>(FILE_SIZE) / (1 << 30);
+    spdlog::info("{}: {:.2f} GiB/s, {:.3f} CPU s/GiB", name, gib / elapsed.count(), (cpuSeconds() - cpu_start) / gib);
+}
+
+// bench_sendfile [path], the 1 GiB file is created at path and removed at the end
+int main(int argc, char** argv) {
+    std::filesystem::path path = argc > 1 ? argv[1] : "/tmp/sylar_bench_sendfile";
+    createFile(path);
+
+    IOContext context;
+    context.execute();
+
+    int port = 8096;
+    for (int round = 0; round < 2; round++) {
+        bench("read + write", port++, path, false);
+        bench("splice      ", port++, path, true);
+    }
+
+    context.stop();
+    std::filesystem::remove(path);
+}
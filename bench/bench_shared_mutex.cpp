@@ -0,0 +1,108 @@
+#include "io_context.h"
+#include "synchronization/mutex.h"
+#include "synchronization/shared_mutex.h"
+#include "synchronization/wait_group.h"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr int FIBERS_PER_PROCESSOR = 4;
+constexpr int NR_READS = 200000;
+constexpr uint64_t NR_ROUTES = 1024;
+
+// A read-mostly routing table: FIBERS_PER_PROCESSOR readers per processor look routes up while a writer replaces one
+// every millisecond. Returns the reads per second over all the processors.
+template <class Lock, class ReadGuard>
+double readRoutes(std::size_t nr_processors) {
+    Lock lock;
+    std::map<uint64_t, uint64_t> routes;
+    for (uint64_t i = 0; i < NR_ROUTES; i++) {
+        routes[i] = i;
+    }
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> checksum{0};
+
+    WaitGroup writer;
+    writer.add();
+    IOContext::spawn([&]() {
+        for (uint64_t i = 0; !stop.load(std::memory_order_relaxed); i++) {
+            {
+                std::lock_guard<Lock> guard(lock);
+                routes[i % NR_ROUTES] = i;
+            }
+            sleepFor(std::chrono::milliseconds(1));
+        }
+        writer.done();
+    });
+
+    WaitGroup readers;
+    readers.add(static_cast<int64_t>(nr_processors * FIBERS_PER_PROCESSOR));
+    auto begin = std::chrono::steady_clock::now();
+    for (std::size_t p = 0; p < nr_processors; p++) {
+        for (int i = 0; i < FIBERS_PER_PROCESSOR; i++) {
+            IOContext::spawnOn(p, [&]() {
+                uint64_t sum = 0;
+                for (int j = 0; j < NR_READS; j++) {
+                    ReadGuard guard(lock);
+                    sum += routes.find(fastRandom() % NR_ROUTES)->second;
+                }
+                checksum.fetch_add(sum, std::memory_order_relaxed);
+                readers.done();
+            });
+        }
+    }
+    readers.wait();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    stop.store(true, std::memory_order_relaxed);
+    writer.wait();
+    return static_cast<double>(nr_processors * FIBERS_PER_PROCESSOR * NR_READS) / elapsed.count();
+}
+
+void bench(std::size_t nr_processors) {
+    IOContext context(IOContext::Options{.thread_count = nr_processors});
+    context.execute();
+
+    auto shared = readRoutes<SharedMutex, std::shared_lock<SharedMutex>>(nr_processors);
+    auto exclusive = readRoutes<Mutex, std::lock_guard<Mutex>>(nr_processors);
+    spdlog::info("{:>3} processors: SharedMutex {:7.2f} M reads/s, Mutex {:7.2f} M reads/s", nr_processors,
+                 shared / 1e6, exclusive / 1e6);
+    context.stop();
+}
+
+// bench_shared_mutex [processors], without arguments 1, 2, 4... up to the number of CPUs each run in a child
+// process since there is one IOContext per process
+int main(int argc, char** argv) {
+    if (argc == 2) {
+        bench(std::stoul(argv[1]));
+        return 0;
+    }
+    auto nr_cpus = std::thread::hardware_concurrency();
+    for (unsigned n = 1;; n *= 2) {
+        n = std::min(n, nr_cpus);
+        auto processors = std::to_string(n);
+        char* args[] = {argv[0], processors.data(), nullptr};
+        pid_t pid{};
+        if (posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, args, environ) != 0) {
+            spdlog::error("posix_spawn failed");
+            return 1;
+        }
+        waitpid(pid, nullptr, 0);
+        if (n == nr_cpus) {
+            break;
+        }
+    }
+}
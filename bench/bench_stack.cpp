@@ -0,0 +1,72 @@
+#include "io_context.h"
+#include "util.h"
+
+#include <chrono>
+#include <fstream>
+#include <latch>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr ptrdiff_t NR_SLEEPING = 10000;
+constexpr ptrdiff_t NR_SPAWN = 200000;
+
+// resident and virtual memory of the process in MiB
+std::pair<double, double> memoryUsage() {
+    std::ifstream statm("/proc/self/statm");
+    double vsz{};
+    double rss{};
+    statm >> vsz >> rss;
+    auto page = static_cast<double>(sysconf(_SC_PAGESIZE)) / 1024 / 1024;
+    return {rss * page, vsz * page};
+}
+
+// keep NR_SLEEPING fibers alive at once, each one holding its stack
+void bench_rss(uint32_t stack_size) {
+    auto [rss_before, vsz_before] = memoryUsage();
+    std::latch started(NR_SLEEPING + 1);
+    std::latch finish(NR_SLEEPING);
+    for (ptrdiff_t i = 0; i < NR_SLEEPING; i++) {
+        IOContext::spawn(
+            [&]() {
+                started.count_down();
+                sleepFor(std::chrono::seconds(1));
+                finish.count_down();
+            },
+            stack_size);
+    }
+    started.arrive_and_wait();
+    auto [rss, vsz] = memoryUsage();
+    finish.wait();
+    spdlog::info("{} fibers with {} KiB stacks: RSS +{:.1f} MiB, VSZ +{:.1f} MiB", NR_SLEEPING, stack_size / 1024,
+                 rss - rss_before, vsz - vsz_before);
+}
+
+// spawn short fibers from inside the runtime, the second round runs on cached stacks
+void bench_spawn_rate() {
+    for (int round = 0; round < 2; round++) {
+        std::latch finish(NR_SPAWN);
+        auto start = std::chrono::steady_clock::now();
+        IOContext::spawn([&]() {
+            for (ptrdiff_t i = 0; i < NR_SPAWN; i++) {
+                IOContext::spawn([&]() { finish.count_down(); });
+            }
+        });
+        finish.wait();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        spdlog::info("round {}: {:.0f} spawns/s", round, static_cast<double>(NR_SPAWN) / elapsed.count());
+    }
+}
+
+int main() {
+    IOContext context(4);
+    context.execute();
+
+    bench_rss(Fiber::DEFAULT_STACK_SIZE);
+    bench_rss(64 * 1024);
+    bench_spawn_rate();
+
+    context.stop();
+}
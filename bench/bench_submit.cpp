@@ -0,0 +1,65 @@
+#include "io_context.h"
+#include "uring_op.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <latch>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+constexpr int NR_FIBERS = 1024;
+constexpr int NR_OPS = 1000;
+
+// every fiber awaits NR_OPS nops, a single processor so every SQE goes through the same ring
+void bench(unsigned ring_entries, unsigned submit_batch) {
+    IOContext context(IOContextOptions{.thread_count = 1, .ring_entries = ring_entries, .submit_batch = submit_batch});
+    context.execute();
+
+    std::latch finish(NR_FIBERS);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < NR_FIBERS; i++) {
+        IOContext::spawn([&]() {
+            for (int op = 0; op < NR_OPS; op++) {
+                static_cast<void>(UringOp().prep_nop().await());
+            }
+            finish.count_down();
+        });
+    }
+    finish.wait();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    auto stats = context.getSubmitStats();
+    spdlog::info("ring {:>4}, batch {:>4}: {:6.2f} Mops/s, {:6.1f} SQEs/submit, {:8.0f} submits/s", ring_entries,
+                 submit_batch, NR_FIBERS * NR_OPS / elapsed.count() / 1e6, stats.sqesPerSubmit(),
+                 static_cast<double>(stats.submits) / elapsed.count());
+    context.stop();
+}
+
+// bench_submit [ring_entries submit_batch], without arguments every configuration runs in a child process since
+// there is one IOContext per process
+int main(int argc, char** argv) {
+    if (argc == 3) {
+        bench(static_cast<unsigned>(std::stoul(argv[1])), static_cast<unsigned>(std::stoul(argv[2])));
+        return 0;
+    }
+    for (unsigned ring_entries : {64U, 256U, 1024U}) {
+        for (unsigned submit_batch : {0U, 1U, 8U, 32U, 128U}) {
+            if (submit_batch > ring_entries) {
+                continue;
+            }
+            auto ring = std::to_string(ring_entries);
+            auto batch = std::to_string(submit_batch);
+            char* args[] = {argv[0], ring.data(), batch.data(), nullptr};
+            pid_t pid{};
+            if (posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, args, environ) != 0) {
+                spdlog::error("posix_spawn failed");
+                return 1;
+            }
+            waitpid(pid, nullptr, 0);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#include "detail/timer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+using namespace std::chrono_literals;
+
+class Wheel : public TimerManager {
+public:
+    using TimerManager::getExpiredCallBacks;
+    using TimerManager::getNextTriggerDuration;
+};
+
+constexpr int NR_TIMERS = 1000000;
+
+double mops(int ops, std::chrono::steady_clock::time_point begin) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return ops / elapsed.count() / 1e6;
+}
+
+int main() {
+    Wheel wheel;
+    std::minstd_rand rand(1);
+    std::vector<TimerManager::TimerHandle> handles;
+    handles.reserve(NR_TIMERS);
+
+    // timeouts spread over 10 minutes, like connection deadlines
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < NR_TIMERS; i++) {
+        handles.push_back(wheel.addTimer(std::chrono::milliseconds(rand() % 600000), []() {}));
+    }
+    spdlog::info("add    {} timers: {:6.2f} Mops/s", NR_TIMERS, mops(NR_TIMERS, begin));
+
+    begin = std::chrono::steady_clock::now();
+    for (auto& handle : handles) {
+        handle.cancel();
+    }
+    spdlog::info("cancel {} timers: {:6.2f} Mops/s", NR_TIMERS, mops(NR_TIMERS, begin));
+
+    // churn: every timer is re-armed once before it fires, as a read deadline of a busy connection
+    handles.clear();
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < NR_TIMERS; i++) {
+        handles.push_back(wheel.addTimer(std::chrono::milliseconds(rand() % 600000), []() {}));
+        handles[static_cast<size_t>(i) / 2].cancel();
+    }
+    spdlog::info("churn  {} timers: {:6.2f} Mops/s, {} left", NR_TIMERS, mops(NR_TIMERS, begin),
+                 wheel.getTimerCount());
+    for (auto& handle : handles) {
+        handle.cancel();
+    }
+
+    // expire: short timeouts fired as the wheel turns
+    int fired = 0;
+    for (int i = 0; i < NR_TIMERS; i++) {
+        wheel.addTimer(std::chrono::microseconds(rand() % 50000), [&fired]() { fired++; });
+    }
+    std::vector<std::function<void()>> cbs;
+    begin = std::chrono::steady_clock::now();
+    while (wheel.hasTimer()) {
+        if (auto timeout = wheel.getNextTriggerDuration()) {
+            std::this_thread::sleep_for(*timeout);
+        }
+        wheel.getExpiredCallBacks(cbs);
+        for (auto& cb : cbs) {
+            cb();
+        }
+        cbs.clear();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+    spdlog::info("expire {} timers in {:.1f} ms", fired, elapsed.count());
+}
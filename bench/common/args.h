@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+namespace sylar::bench {
+    // command line of the form --name value or --flag
+    class Args {
+    public:
+        Args(int argc, char** argv) : argc_(argc), argv_(argv) {}
+
+        bool has(std::string_view name) const { return find(name) != 0; }
+
+        std::string get(std::string_view name, std::string fallback) const {
+            auto i = find(name);
+            if (i == 0) {
+                return fallback;
+            }
+            if (i + 1 >= argc_) {
+                spdlog::error("--{} needs a value", name);
+                std::exit(1);
+            }
+            return argv_[i + 1];
+        }
+        long getInt(std::string_view name, long fallback) const {
+            auto value = get(name, std::string());
+            return value.empty() ? fallback : std::stol(value);
+        }
+        double getDouble(std::string_view name, double fallback) const {
+            auto value = get(name, std::string());
+            return value.empty() ? fallback : std::stod(value);
+        }
+
+    private:
+        // index of --name, 0 if it's not there
+        int find(std::string_view name) const {
+            for (int i = 1; i < argc_; i++) {
+                std::string_view arg = argv_[i];
+                if (arg.starts_with("--") && arg.substr(2) == name) {
+                    return i;
+                }
+            }
+            return 0;
+        }
+
+        int argc_;
+        char** argv_;
+    };
+
+} // namespace sylar::bench
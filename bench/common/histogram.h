@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace sylar::bench {
+    // Latency histogram with the bucket layout of HdrHistogram: values from 1 to highest are recorded with
+    // significant_digits decimal digits of precision, in power of 2 buckets of linear sub-buckets. Recording is an
+    // index computation and an increment, percentiles are exact up to the precision.
+    class Histogram {
+    public:
+        // 60 s in nanoseconds by default
+        explicit Histogram(int64_t highest = 60'000'000'000, int significant_digits = 3) : highest_(highest) {
+            int64_t largest = 2;
+            for (int i = 0; i < significant_digits; i++) {
+                largest *= 10;
+            }
+            sub_bucket_count_ = std::bit_ceil(static_cast<uint64_t>(largest));
+            sub_bucket_half_magnitude_ = std::countr_zero(sub_bucket_count_) - 1;
+            sub_bucket_mask_ = sub_bucket_count_ - 1;
+
+            int buckets = 1;
+            for (auto untrackable = sub_bucket_count_; untrackable <= static_cast<uint64_t>(highest);
+                 untrackable <<= 1) {
+                buckets++;
+            }
+            counts_.resize(static_cast<std::size_t>(buckets + 1) << sub_bucket_half_magnitude_);
+        }
+
+        // values out of range are clamped
+        void record(int64_t value, uint64_t count = 1) {
+            value = std::clamp<int64_t>(value, 0, highest_);
+            counts_[index(static_cast<uint64_t>(value))] += count;
+            total_ += count;
+            sum_ += static_cast<double>(value) * static_cast<double>(count);
+            min_ = std::min(min_, value);
+            max_ = std::max(max_, value);
+        }
+
+        // the layouts must be the same
+        void merge(Histogram const& that) {
+            for (std::size_t i = 0; i < counts_.size() && i < that.counts_.size(); i++) {
+                counts_[i] += that.counts_[i];
+            }
+            total_ += that.total_;
+            sum_ += that.sum_;
+            min_ = std::min(min_, that.min_);
+            max_ = std::max(max_, that.max_);
+        }
+
+        // the highest value equivalent to the one at percentile p, in [0, 100]
+        int64_t percentile(double p) const {
+            if (total_ == 0) {
+                return 0;
+            }
+            auto target = static_cast<uint64_t>(static_cast<double>(total_) * std::clamp(p, 0.0, 100.0) / 100.0);
+            target = std::max<uint64_t>(target, 1);
+            uint64_t seen = 0;
+            for (std::size_t i = 0; i < counts_.size(); i++) {
+                seen += counts_[i];
+                if (seen >= target) {
+                    return std::min(highestEquivalent(i), max_);
+                }
+            }
+            return max_;
+        }
+
+        uint64_t count() const { return total_; }
+        int64_t min() const { return total_ == 0 ? 0 : min_; }
+        int64_t max() const { return max_; }
+        double mean() const { return total_ == 0 ? 0 : sum_ / static_cast<double>(total_); }
+
+    private:
+        std::size_t index(uint64_t value) const {
+            auto bucket = 64 - std::countl_zero(value | sub_bucket_mask_) - (sub_bucket_half_magnitude_ + 1);
+            auto sub_bucket = value >> bucket;
+            auto half_count = uint64_t{1} << sub_bucket_half_magnitude_;
+            return static_cast<std::size_t>((static_cast<uint64_t>(bucket + 1) << sub_bucket_half_magnitude_) +
+                                            (sub_bucket - half_count));
+        }
+
+        int64_t highestEquivalent(std::size_t index) const {
+            auto half_count = uint64_t{1} << sub_bucket_half_magnitude_;
+            auto bucket = static_cast<int>(index >> sub_bucket_half_magnitude_) - 1;
+            auto sub_bucket = (index & (half_count - 1)) + half_count;
+            if (bucket < 0) {
+                sub_bucket -= half_count;
+                bucket = 0;
+            }
+            return static_cast<int64_t>(((sub_bucket + 1) << bucket) - 1);
+        }
+
+        int64_t highest_;
+        uint64_t sub_bucket_count_;
+        int sub_bucket_half_magnitude_;
+        uint64_t sub_bucket_mask_;
+        std::vector<uint64_t> counts_;
+        uint64_t total_{};
+        double sum_{};
+        int64_t min_{std::numeric_limits<int64_t>::max()};
+        int64_t max_{};
+    };
+
+} // namespace sylar::bench
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "histogram.h"
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+
+namespace sylar::bench {
+    // Results of a bench as JSON, so that runs can be compared across releases:
+    // {"suite": ..., "timestamp": ..., "hardware_concurrency": ..., "results": [{"name": ..., "metrics": {...}}]}
+    // the unit of a metric is the suffix of its key.
+    class Report {
+    public:
+        class Result {
+        public:
+            explicit Result(std::string name) : name_(std::move(name)) {}
+
+            Result& set(std::string key, double value) {
+                metrics_.emplace_back(std::move(key), value);
+                return *this;
+            }
+            // percentiles of a histogram recorded in nanoseconds, in microseconds
+            Result& setLatency(Histogram const& histogram) {
+                set("latency_count", static_cast<double>(histogram.count()));
+                set("latency_mean_us", histogram.mean() / 1e3);
+                for (auto [key, p] : {std::pair{"latency_p50_us", 50.0}, std::pair{"latency_p90_us", 90.0},
+                                      std::pair{"latency_p99_us", 99.0}, std::pair{"latency_p999_us", 99.9}}) {
+                    set(key, static_cast<double>(histogram.percentile(p)) / 1e3);
+                }
+                return set("latency_max_us", static_cast<double>(histogram.max()) / 1e3);
+            }
+
+        private:
+            friend class Report;
+            std::string name_;
+            std::vector<std::pair<std::string, double>> metrics_;
+        };
+
+        explicit Report(std::string suite) : suite_(std::move(suite)) {}
+
+        // the result is logged as well once the report is written
+        Result& add(std::string name) { return results_.emplace_back(std::move(name)); }
+
+        std::string toJson() const {
+            auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+                                 std::chrono::system_clock::now().time_since_epoch())
+                                 .count();
+            std::string json = fmt::format("{{\"suite\": \"{}\", \"timestamp\": {}, \"hardware_concurrency\": {}, "
+                                           "\"results\": [",
+                                           suite_, timestamp, std::thread::hardware_concurrency());
+            for (std::size_t i = 0; i < results_.size(); i++) {
+                json += fmt::format("{}\n  {{\"name\": \"{}\", \"metrics\": {{", i == 0 ? "" : ",", results_[i].name_);
+                auto const& metrics = results_[i].metrics_;
+                for (std::size_t j = 0; j < metrics.size(); j++) {
+                    json += fmt::format("{}\"{}\": {:.6g}", j == 0 ? "" : ", ", metrics[j].first, metrics[j].second);
+                }
+                json += "}}";
+            }
+            json += "\n]}\n";
+            return json;
+        }
+
+        // write the JSON into path, onto stdout if path is empty
+        void write(std::string const& path) const {
+            for (auto const& result : results_) {
+                std::string line;
+                for (auto const& [key, value] : result.metrics_) {
+                    line += fmt::format(" {} {:.6g}", key, value);
+                }
+                spdlog::info("{}:{}", result.name_, line);
+            }
+            auto json = toJson();
+            auto* file = path.empty() ? stdout : std::fopen(path.c_str(), "w");
+            if (file == nullptr) {
+                spdlog::error("can't open {}", path);
+                return;
+            }
+            std::fwrite(json.data(), 1, json.size(), file);
+            if (file != stdout) {
+                std::fclose(file);
+            }
+        }
+
+    private:
+        std::string suite_;
+        // references returned by add stay valid
+        std::deque<Result> results_;
+    };
+
+} // namespace sylar::bench
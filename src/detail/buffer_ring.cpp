@@ -0,0 +1,42 @@
+#include "buffer_ring.h"
+#include "util.h"
+
+#include <sys/mman.h>
+#include <system_error>
+
+namespace sylar {
+    BufferRing::BufferRing(io_uring* ring, uint16_t group, unsigned entries, uint32_t buffer_size)
+        : ring_(ring), group_(group), entries_(entries), buffer_size_(buffer_size) {
+        assertThat(entries != 0 && (entries & (entries - 1)) == 0, "entries must be a power of 2");
+        auto size = static_cast<std::size_t>(entries) * buffer_size;
+        void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (addr == MAP_FAILED) [[unlikely]] {
+            throw std::system_error(errno, std::system_category(), "mmap buffer ring");
+        }
+        buffers_ = static_cast<char*>(addr);
+
+        int ret = 0;
+        br_ = io_uring_setup_buf_ring(ring_, entries_, group_, 0, &ret);
+        if (br_ == nullptr) [[unlikely]] {
+            munmap(buffers_, size);
+            throw std::system_error(-ret, std::system_category(), "io_uring_setup_buf_ring");
+        }
+        for (unsigned i = 0; i < entries_; i++) {
+            auto bid = static_cast<uint16_t>(i);
+            io_uring_buf_ring_add(br_, buffer(bid, 0).data(), buffer_size_, bid, io_uring_buf_ring_mask(entries_),
+                                  static_cast<int>(i));
+        }
+        io_uring_buf_ring_advance(br_, static_cast<int>(entries_));
+    }
+
+    BufferRing::~BufferRing() {
+        io_uring_free_buf_ring(ring_, br_, entries_, group_);
+        munmap(buffers_, static_cast<std::size_t>(entries_) * buffer_size_);
+    }
+
+    void BufferRing::release(uint16_t bid) noexcept {
+        io_uring_buf_ring_add(br_, buffer(bid, 0).data(), buffer_size_, bid, io_uring_buf_ring_mask(entries_), 0);
+        io_uring_buf_ring_advance(br_, 1);
+    }
+
+} // namespace sylar
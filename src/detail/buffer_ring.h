@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <liburing.h>
+#include <span>
+
+namespace sylar {
+    // Provided buffer ring of a processor: the kernel picks a buffer only when data arrives for a recv submitted
+    // with IOSQE_BUFFER_SELECT, the reader gives it back once the data is consumed. Receive memory is bounded by
+    // entries * buffer_size per processor whatever the number of connections, pages are committed as the kernel
+    // first fills them (MAP_NORESERVE). Only the processor thread may touch it.
+    class BufferRing {
+    public:
+        // entries must be a power of 2
+        BufferRing(io_uring* ring, uint16_t group, unsigned entries, uint32_t buffer_size);
+        ~BufferRing();
+
+        BufferRing(BufferRing&&) = delete;
+
+        uint16_t group() const noexcept { return group_; }
+        uint32_t bufferSize() const noexcept { return buffer_size_; }
+
+        std::span<char> buffer(uint16_t bid, std::size_t len) const noexcept {
+            return {buffers_ + static_cast<std::size_t>(bid) * buffer_size_, len};
+        }
+        // hand the buffer bid back to the kernel
+        void release(uint16_t bid) noexcept;
+
+    private:
+        io_uring* ring_;
+        io_uring_buf_ring* br_{};
+        uint16_t group_;
+        unsigned entries_;
+        uint32_t buffer_size_;
+        char* buffers_{};
+    };
+
+} // namespace sylar
@@ -1,5 +1,6 @@
 #include "fiber.h"
 #include "processor.h"
+#include "tracer.h"
 #include "util.h"
 
 #include <cassert>
@@ -19,8 +20,8 @@ namespace sylar {
     Fiber* Fiber::newFiber(Func func, uint32_t stack_size) { return new Fiber(std::move(func), stack_size); }
 
     Fiber::Fiber(Func func, uint32_t stack_size)
-        : stack_size_(stack_size), func_(std::move(func)), stack_(std::make_unique<char[]>(stack_size_)),
-          context_(make_fcontext(stack_.get() + stack_size_, stack_size_, &Fiber::run)) {
+        : stack_size_(stack_size), func_(std::move(func)), stack_(StackAllocator::allocate(stack_size_)),
+          context_(make_fcontext(stack_.top(), stack_.size_, &Fiber::run)) {
 
         if (func_) {
             state_ = READY;
@@ -30,13 +31,16 @@ namespace sylar {
     void Fiber::reset(Func func) {
         state_ = READY;
         func_ = std::move(func);
+        pinned_.reset();
+        home_.reset();
 
-        context_ = make_fcontext(stack_.get() + stack_size_, stack_size_, &Fiber::run);
+        context_ = make_fcontext(stack_.top(), stack_.size_, &Fiber::run);
     }
 
     Fiber::~Fiber() {
         if (stack_) {
             assertThat(state_ == INIT || state_ == TERM || state_ == EXCEPT);
+            StackAllocator::deallocate(stack_);
         } else {
             // main fiber
             checkRet(!func_);
@@ -52,6 +56,7 @@ namespace sylar {
 
         state_ = EXEC;
         t_current_fiber = this;
+        trace(TraceEvent::FiberResume, this);
         context_ = jump_fcontext(context_, nullptr).fctx;
     }
 
@@ -64,6 +69,7 @@ namespace sylar {
 
         state_ = state;
         assertThat(state_ != EXEC);
+        trace(TraceEvent::FiberYield, this, state);
         getCurrentMainFiber()->context_ = jump_fcontext(t_current_fiber->context_, nullptr).fctx;
     }
 
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "stack.h"
+
 #include <boost/context/detail/fcontext.hpp>
 #include <functional>
 #include <memory>
+#include <optional>
 
 namespace sylar {
 
@@ -31,6 +34,7 @@ namespace sylar {
             return state_str[static_cast<std::size_t>(state_)];
         };
         State getState() { return state_; }
+        uint32_t getStackSize() const { return stack_size_; }
 
     private:
         friend class RunQueue;
@@ -45,9 +49,13 @@ namespace sylar {
 
         State state_{INIT};
         uint32_t stack_size_{};
+        // the processor the fiber must run on, see Processor::pin
+        std::optional<uint64_t> pinned_;
+        // the processor wakeups send the fiber back to, see Affinity::Soft
+        std::optional<uint64_t> home_;
 
         Func func_;
-        std::unique_ptr<char[]> stack_;
+        Stack stack_;
 
         boost::context::detail::fcontext_t context_{};
 
@@ -0,0 +1,26 @@
+#include "pipe.h"
+#include "hook.h"
+#include "util.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace sylar {
+    Pipe::Pipe() {
+        int fds[2];
+        checkRet(pipe2(fds, O_CLOEXEC));
+        read_fd_ = fds[0];
+        write_fd_ = fds[1];
+        // best effort, an unprivileged process is limited by pipe-max-size and pipe-user-pages-soft
+        fcntl(write_fd_, F_SETPIPE_SZ, PIPE_SIZE);
+        size_ = static_cast<unsigned>(checkRet(fcntl(write_fd_, F_GETPIPE_SZ)));
+    }
+
+    Pipe::~Pipe() {
+        if (read_fd_ >= 0) {
+            close_f(read_fd_);
+            close_f(write_fd_);
+        }
+    }
+
+} // namespace sylar
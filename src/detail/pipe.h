@@ -0,0 +1,35 @@
+#pragma once
+
+#include <utility>
+
+namespace sylar {
+    // Kernel buffer for splicing between two files which are not pipes. The capacity is raised to PIPE_SIZE when
+    // /proc/sys/fs/pipe-max-size allows it, size() tells what was granted.
+    class Pipe {
+    public:
+        static constexpr int PIPE_SIZE = 1 << 20;
+
+        Pipe();
+        ~Pipe();
+
+        Pipe(Pipe&& that) noexcept
+            : read_fd_(std::exchange(that.read_fd_, -1)), write_fd_(std::exchange(that.write_fd_, -1)),
+              size_(that.size_) {}
+        Pipe& operator=(Pipe&& that) noexcept {
+            std::swap(read_fd_, that.read_fd_);
+            std::swap(write_fd_, that.write_fd_);
+            std::swap(size_, that.size_);
+            return *this;
+        }
+
+        int readFd() const noexcept { return read_fd_; }
+        int writeFd() const noexcept { return write_fd_; }
+        unsigned size() const noexcept { return size_; }
+
+    private:
+        int read_fd_{-1};
+        int write_fd_{-1};
+        unsigned size_{};
+    };
+
+} // namespace sylar
@@ -0,0 +1,118 @@
+#include "stack.h"
+#include "util.h"
+
+#include <algorithm>
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace sylar {
+    namespace {
+        std::size_t pageSize() {
+            static const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+            return page_size;
+        }
+
+        Stack mapStack(std::size_t size) {
+            auto page_size = pageSize();
+            void* addr = mmap(nullptr, size + page_size, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+            if (addr == MAP_FAILED) [[unlikely]] {
+                throw std::system_error(errno, std::system_category(), "mmap stack");
+            }
+            // stacks grow down, overflowing into the guard page faults instead of corrupting the neighbour
+            checkRet(mprotect(addr, page_size, PROT_NONE));
+            return Stack{static_cast<char*>(addr) + page_size, size};
+        }
+
+        void unmapStack(Stack stack) { checkRet(munmap(stack.base_ - pageSize(), stack.size_ + pageSize())); }
+
+        Stack takeStack(std::vector<Stack>& stacks, std::size_t size) {
+            auto it = std::find_if(stacks.rbegin(), stacks.rend(), [size](Stack s) { return s.size_ == size; });
+            if (it == stacks.rend()) {
+                return {};
+            }
+            auto stack = *it;
+            stacks.erase(std::next(it).base());
+            return stack;
+        }
+
+        struct GlobalPool {
+            std::mutex mutex_;
+            std::vector<Stack> stacks_;
+
+            // resident: the pages of stack haven't been released yet
+            void put(Stack stack, bool resident = true) {
+                // the pool is for idle stacks, don't keep their pages
+                if (resident) {
+                    StackAllocator::release(stack);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (stacks_.size() < StackAllocator::GLOBAL_POOL_SIZE) {
+                        stacks_.push_back(stack);
+                        return;
+                    }
+                }
+                unmapStack(stack);
+            }
+
+            Stack take(std::size_t size) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return takeStack(stacks_, size);
+            }
+        };
+
+        GlobalPool& globalPool() {
+            static GlobalPool pool;
+            return pool;
+        }
+
+        // the last stacks freed are taken first, only the last LOCAL_RESIDENT_SIZE keep their pages
+        struct LocalCache {
+            std::vector<Stack> stacks_;
+
+            bool isResident(std::size_t index) const {
+                return index + StackAllocator::LOCAL_RESIDENT_SIZE >= stacks_.size();
+            }
+
+            ~LocalCache() {
+                for (std::size_t i = 0; i < stacks_.size(); i++) {
+                    globalPool().put(stacks_[i], isResident(i));
+                }
+            }
+        };
+
+        thread_local LocalCache t_cache;
+    } // namespace
+
+    Stack StackAllocator::allocate(std::size_t size) {
+        auto page_size = pageSize();
+        size = (size + page_size - 1) / page_size * page_size;
+
+        if (auto stack = takeStack(t_cache.stacks_, size)) {
+            return stack;
+        }
+        if (auto stack = globalPool().take(size)) {
+            return stack;
+        }
+        return mapStack(size);
+    }
+
+    void StackAllocator::deallocate(Stack stack) {
+        auto cached = t_cache.stacks_.size();
+        if (cached >= LOCAL_CACHE_SIZE) {
+            globalPool().put(stack);
+            return;
+        }
+        // bound the memory of the cache, the stack dropping out of the last LOCAL_RESIDENT_SIZE gives its pages back
+        if (cached >= LOCAL_RESIDENT_SIZE) {
+            release(t_cache.stacks_[cached - LOCAL_RESIDENT_SIZE]);
+        }
+        t_cache.stacks_.push_back(stack);
+    }
+
+    void StackAllocator::release(Stack stack) { checkRet(madvise(stack.base_, stack.size_, MADV_DONTNEED)); }
+
+} // namespace sylar
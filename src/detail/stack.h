@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+namespace sylar {
+    struct Stack {
+        char* base_{}; // lowest usable address, the guard page lies right below it
+        std::size_t size_{};
+
+        char* top() const noexcept { return base_ + size_; }
+        explicit operator bool() const noexcept { return base_ != nullptr; }
+    };
+
+    // Fiber stacks are mapped with MAP_NORESERVE and a PROT_NONE guard page, only the touched pages are committed.
+    // Freed stacks are cached by the freeing thread (one per processor), overflow into a bounded global pool and are
+    // unmapped beyond that. Idle stacks give their pages back by MADV_DONTNEED, except for the last LOCAL_RESIDENT_SIZE
+    // freed into a thread cache, which are the next ones reused.
+    class StackAllocator {
+    public:
+        static constexpr std::size_t LOCAL_CACHE_SIZE = 64;
+        static constexpr std::size_t LOCAL_RESIDENT_SIZE = 8;
+        static constexpr std::size_t GLOBAL_POOL_SIZE = 1024;
+
+        static Stack allocate(std::size_t size);
+        static void deallocate(Stack stack);
+        // give the pages of an idle stack back, it stays mapped
+        static void release(Stack stack);
+    };
+
+} // namespace sylar
@@ -1,64 +1,184 @@
 #include "timer.h"
 
-#include <functional>
-#include <memory>
-#include <optional>
-#include <print>
-#include <spdlog/spdlog.h>
-#include <utility>
+#include <algorithm>
+#include <bit>
 
 namespace sylar {
-    TimerManager::Timer::Timer(std::chrono::system_clock::duration period, std::function<void()> cb, bool recurring,
-                               TimerManager* manager)
-        : recurring_(recurring), period_(period), next_trigger_time_(std::chrono::system_clock::now() + period),
-          cb_(std::move(cb)), manager_(manager) {}
+    namespace {
+        // move all nodes of list into an empty one
+        template <class Node>
+        void splice(Node& from, Node& to) {
+            if (from.empty()) {
+                return;
+            }
+            to.next_ = from.next_;
+            to.prev_ = from.prev_;
+            to.next_->prev_ = &to;
+            to.prev_->next_ = &to;
+            from.next_ = from.prev_ = &from;
+        }
+    } // namespace
 
-    bool TimerManager::Timer::cancel() {
-        if (expired_) {
+    bool TimerManager::TimerHandle::cancel() {
+        if (timer_ == nullptr || timer_->id_ != id_) {
             return false;
         }
-        manager_->timers_.erase(shared_from_this());
+        manager_->cancel(timer_);
+        timer_ = nullptr;
         return true;
     }
 
-    std::shared_ptr<TimerManager::Timer> TimerManager::addTimer(std::chrono::system_clock::duration period,
-                                                                std::function<void()> cb, bool recurring) {
-        auto timer = std::make_shared<TimerManager::Timer>(period, std::move(cb), recurring, this);
-        timers_.insert(timer);
-        return timer;
+    TimerManager::TimerHandle TimerManager::addTimer(Clock::duration period, Func cb, bool recurring) {
+        auto* timer = allocTimer();
+        timer->cb_ = std::move(cb);
+        timer->recurring_ = recurring;
+        timer->period_ = std::max<uint64_t>(1, static_cast<uint64_t>((period + TICK - Clock::duration(1)) / TICK));
+        timer->expire_ = toTicks(Clock::now() + period);
+        insert(timer);
+        ++size_;
+        return {this, timer};
     }
 
-    std::optional<std::chrono::system_clock::duration> TimerManager::getNextTriggerDuration() {
-        if (timers_.empty()) {
-            return std::nullopt;
+    uint64_t TimerManager::toTicks(Clock::time_point time) const {
+        if (time <= start_) {
+            return 0;
         }
-        auto now = std::chrono::system_clock::now();
-        auto timer = *timers_.begin();
-        if (timer->next_trigger_time_ > now) {
-            return timer->next_trigger_time_ - now;
-        }
-        return std::chrono::seconds(0);
+        return static_cast<uint64_t>((time - start_ + TICK - Clock::duration(1)) / TICK);
     }
 
-    std::vector<TimerManager::Func> TimerManager::getExpiredCallBacks() {
-        std::vector<Func> cbs;
-        while (!timers_.empty()) {
-            auto now = std::chrono::system_clock::now();
-            auto timer_it = timers_.begin();
-            const auto& timer = *timer_it;
-            if (timer->next_trigger_time_ > now) {
-                break;
+    void TimerManager::insert(Timer* timer) {
+        timer->expire_ = std::max(timer->expire_, current_);
+        auto diff = timer->expire_ - current_;
+        if (diff < ROOT_SIZE) {
+            auto index = timer->expire_ & (ROOT_SIZE - 1);
+            timer->slot_ = &root_[index];
+            root_bitmap_[index / 64] |= uint64_t{1} << (index % 64);
+        } else {
+            // timers too far away are parked in the last level and inserted again when they cascade
+            auto place = current_ + std::min(diff, MAX_TICKS);
+            unsigned level = 0;
+            while (level + 1 < NR_LEVELS && diff >= uint64_t{1} << (ROOT_BITS + (level + 1) * LEVEL_BITS)) {
+                ++level;
             }
-            cbs.push_back(timer->cb_);
-            timers_.erase(timer_it);
-            if (timer->recurring_) {
-                timer->next_trigger_time_ = now + timer->period_;
-                timers_.insert(timer);
+            auto index = (place >> (ROOT_BITS + level * LEVEL_BITS)) & (LEVEL_SIZE - 1);
+            timer->slot_ = &levels_[level][index];
+        }
+        timer->slot_->pushBack(timer);
+    }
+
+    void TimerManager::cancel(Timer* timer) {
+        auto* slot = timer->slot_;
+        timer->unlink();
+        if (slot->empty() && slot >= root_.data() && slot < root_.data() + ROOT_SIZE) {
+            auto index = static_cast<uint64_t>(slot - root_.data());
+            root_bitmap_[index / 64] &= ~(uint64_t{1} << (index % 64));
+        }
+        freeTimer(timer);
+        --size_;
+    }
+
+    void TimerManager::cascade(unsigned level, uint64_t index) {
+        ListNode timers;
+        splice(levels_[level][index], timers);
+        while (!timers.empty()) {
+            auto* timer = static_cast<Timer*>(timers.next_);
+            timer->unlink();
+            insert(timer);
+        }
+    }
+
+    void TimerManager::expire(ListNode& slot, std::vector<Func>& cbs) {
+        ListNode timers;
+        splice(slot, timers);
+        while (!timers.empty()) {
+            auto* timer = static_cast<Timer*>(timers.next_);
+            timer->unlink();
+            if (timer->expire_ > current_) {
+                insert(timer);
+            } else if (timer->recurring_) {
+                cbs.push_back(timer->cb_);
+                timer->expire_ = current_ + timer->period_;
+                insert(timer);
             } else {
-                timer->expired_ = true;
+                cbs.push_back(std::move(timer->cb_));
+                freeTimer(timer);
+                --size_;
+            }
+        }
+    }
+
+    uint64_t TimerManager::nextRootSlot(uint64_t index) const {
+        for (auto word = index / 64; word < root_bitmap_.size(); word++) {
+            auto bits = root_bitmap_[word];
+            if (word == index / 64) {
+                bits &= ~uint64_t{0} << (index % 64);
+            }
+            if (bits != 0) {
+                return word * 64 + static_cast<uint64_t>(std::countr_zero(bits));
             }
         }
-        return cbs;
+        return ROOT_SIZE;
+    }
+
+    std::optional<TimerManager::Clock::duration> TimerManager::getNextTriggerDuration() {
+        if (size_ == 0) {
+            return std::nullopt;
+        }
+        // the next non-empty root slot, or the next cascade if the rest of the root level is empty
+        auto index = current_ & (ROOT_SIZE - 1);
+        auto tick = current_ - index + nextRootSlot(index);
+        auto deadline = start_ + static_cast<int64_t>(tick) * TICK;
+        auto now = Clock::now();
+        if (deadline > now) {
+            return deadline - now;
+        }
+        return Clock::duration(0);
+    }
+
+    void TimerManager::getExpiredCallBacks(std::vector<Func>& cbs) {
+        auto now = Clock::now();
+        auto now_tick = static_cast<uint64_t>((now - start_) / TICK);
+        if (size_ == 0) {
+            current_ = std::max(current_, now_tick + 1);
+            return;
+        }
+
+        while (current_ <= now_tick) {
+            auto index = current_ & (ROOT_SIZE - 1);
+            if (index == 0) {
+                for (unsigned level = 0; level < NR_LEVELS; level++) {
+                    auto level_index = (current_ >> (ROOT_BITS + level * LEVEL_BITS)) & (LEVEL_SIZE - 1);
+                    cascade(level, level_index);
+                    if (level_index != 0) {
+                        break;
+                    }
+                }
+            }
+
+            root_bitmap_[index / 64] &= ~(uint64_t{1} << (index % 64));
+            expire(root_[index], cbs);
+
+            // skip the empty slots up to the next cascade
+            auto base = current_ - index;
+            current_ = std::min(now_tick + 1, base + nextRootSlot(index + 1));
+            current_ = std::max(current_, base + index + 1);
+        }
+    }
+
+    TimerManager::Timer* TimerManager::allocTimer() {
+        if (!free_nodes_.empty()) {
+            auto* timer = free_nodes_.back();
+            free_nodes_.pop_back();
+            return timer;
+        }
+        return &nodes_.emplace_back();
+    }
+
+    void TimerManager::freeTimer(Timer* timer) {
+        // invalidate the handles of this timer
+        ++timer->id_;
+        timer->cb_ = nullptr;
+        free_nodes_.push_back(timer);
     }
 
 } // namespace sylar
@@ -1,49 +1,114 @@
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <cstdint>
+#include <deque>
 #include <functional>
-#include <memory>
-#include <set>
+#include <optional>
+#include <vector>
 
 namespace sylar {
+    // Hierarchical timing wheel: insert and cancel are O(1), timer nodes are intrusive and recycled, expired timers
+    // cascade down the levels as the wheel turns. Timers fire on the first tick after they expire.
     class TimerManager {
         using Func = std::function<void()>;
 
+    public:
+        using Clock = std::chrono::steady_clock;
+        static constexpr Clock::duration TICK = std::chrono::milliseconds(1);
+
     private:
-        class Timer : public std::enable_shared_from_this<Timer> {
-            friend class TimerManager;
+        struct ListNode {
+            ListNode* prev_{this};
+            ListNode* next_{this};
 
+            bool empty() const { return next_ == this; }
+            void unlink() {
+                prev_->next_ = next_;
+                next_->prev_ = prev_;
+                prev_ = next_ = this;
+            }
+            void pushBack(ListNode* node) {
+                node->prev_ = prev_;
+                node->next_ = this;
+                prev_->next_ = node;
+                prev_ = node;
+            }
+        };
+
+        struct Timer : ListNode {
+            ListNode* slot_{};
+            uint64_t id_{};
+            uint64_t expire_{}; // in ticks
+            uint64_t period_{}; // in ticks
+            bool recurring_{};
+            Func cb_;
+        };
+
+    public:
+        class TimerHandle {
         public:
-            Timer(std::chrono::system_clock::duration period, std::function<void()> cb, bool recurring,
-                  TimerManager* manager);
+            TimerHandle() = default;
 
+            // return false if the timer has already expired or been cancelled
             bool cancel();
 
         private:
-            bool expired_{false};
-            bool recurring_{};
-            std::chrono::system_clock::duration period_;
-            std::chrono::system_clock::time_point next_trigger_time_;
-            std::function<void()> cb_;
-            TimerManager* manager_;
-
-            struct Comparator {
-                bool operator()(const std::shared_ptr<Timer>& lhs, const std::shared_ptr<Timer>& rhs) const {
-                    return lhs->next_trigger_time_ <= rhs->next_trigger_time_;
-                }
-            };
+            friend class TimerManager;
+            TimerHandle(TimerManager* manager, Timer* timer) : manager_(manager), timer_(timer), id_(timer->id_) {}
+
+            TimerManager* manager_{};
+            Timer* timer_{};
+            uint64_t id_{};
         };
 
-    public:
-        std::shared_ptr<Timer> addTimer(std::chrono::system_clock::duration period, std::function<void()> cb,
-                                        bool recurring = false);
+        TimerManager() = default;
+        TimerManager(TimerManager const&) = delete;
+        TimerManager& operator=(TimerManager const&) = delete;
+
+        TimerHandle addTimer(Clock::duration period, Func cb, bool recurring = false);
 
-        bool hasTimer() { return timers_.size() != 0; }
+        bool hasTimer() const { return size_ != 0; }
+        std::size_t getTimerCount() const { return size_; }
 
     protected:
-        std::optional<std::chrono::system_clock::duration> getNextTriggerDuration();
-        std::vector<Func> getExpiredCallBacks();
-        std::set<std::shared_ptr<Timer>, Timer::Comparator> timers_;
+        std::optional<Clock::duration> getNextTriggerDuration();
+        // append the callbacks of expired timers to cbs, the clock is read once
+        void getExpiredCallBacks(std::vector<Func>& cbs);
+
+    private:
+        static constexpr unsigned ROOT_BITS = 8;
+        static constexpr unsigned LEVEL_BITS = 6;
+        static constexpr unsigned NR_LEVELS = 4;
+        static constexpr uint64_t ROOT_SIZE = 1 << ROOT_BITS;
+        static constexpr uint64_t LEVEL_SIZE = 1 << LEVEL_BITS;
+        static constexpr uint64_t MAX_TICKS = (uint64_t{1} << (ROOT_BITS + NR_LEVELS * LEVEL_BITS)) - 1;
+
+        uint64_t toTicks(Clock::time_point time) const;
+
+        void insert(Timer* timer);
+        void cancel(Timer* timer);
+        void cascade(unsigned level, uint64_t index);
+        void expire(ListNode& slot, std::vector<Func>& cbs);
+        // first non-empty root slot from index, ROOT_SIZE if none
+        uint64_t nextRootSlot(uint64_t index) const;
+
+        Timer* allocTimer();
+        void freeTimer(Timer* timer);
+
+        Clock::time_point start_{Clock::now()};
+        // all ticks before current_ have been processed
+        uint64_t current_{};
+        std::size_t size_{};
+
+        std::array<ListNode, ROOT_SIZE> root_;
+        std::array<std::array<ListNode, LEVEL_SIZE>, NR_LEVELS> levels_;
+        // non-empty slots of the root level
+        std::array<uint64_t, ROOT_SIZE / 64> root_bitmap_{};
+
+        std::deque<Timer> nodes_;
+        std::vector<Timer*> free_nodes_;
     };
 
 } // namespace sylar
@@ -0,0 +1,161 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sched.h>
+#include <string>
+#include <thread>
+#include <tuple>
+
+#include <spdlog/spdlog.h>
+
+namespace sylar {
+    namespace {
+        const std::filesystem::path SYSFS_CPU = "/sys/devices/system/cpu";
+        const std::filesystem::path SYSFS_NODE = "/sys/devices/system/node";
+
+        std::string readLine(std::filesystem::path const& path) {
+            std::ifstream file(path);
+            std::string line;
+            std::getline(file, line);
+            return line;
+        }
+
+        // first CPU of the list in the file, fallback if there is none
+        int firstCpu(std::filesystem::path const& path, int fallback) {
+            auto cpus = parseCpuList(readLine(path));
+            return cpus.empty() ? fallback : *std::min_element(cpus.begin(), cpus.end());
+        }
+
+        // CPUs sharing the highest level data or unified cache with cpu
+        int lastLevelCache(int cpu, int fallback) {
+            std::error_code ec;
+            int best_level = 0;
+            int llc = fallback;
+            for (auto const& entry :
+                 std::filesystem::directory_iterator(SYSFS_CPU / ("cpu" + std::to_string(cpu)) / "cache", ec)) {
+                if (!entry.path().filename().string().starts_with("index") ||
+                    readLine(entry.path() / "type") == "Instruction") {
+                    continue;
+                }
+                int level = 0;
+                auto text = readLine(entry.path() / "level");
+                std::from_chars(text.data(), text.data() + text.size(), level);
+                if (level > best_level) {
+                    best_level = level;
+                    llc = firstCpu(entry.path() / "shared_cpu_list", fallback);
+                }
+            }
+            return llc;
+        }
+    } // namespace
+
+    std::vector<int> parseCpuList(std::string_view list) {
+        std::vector<int> cpus;
+        while (!list.empty()) {
+            auto range = list.substr(0, list.find(','));
+            list.remove_prefix(std::min(list.size(), range.size() + 1));
+            int first = 0;
+            auto [ptr, ec] = std::from_chars(range.data(), range.data() + range.size(), first);
+            if (ec != std::errc()) {
+                continue;
+            }
+            int last = first;
+            if (ptr != range.data() + range.size() && *ptr == '-') {
+                std::from_chars(ptr + 1, range.data() + range.size(), last);
+            }
+            for (int cpu = first; cpu <= last; cpu++) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    int cpuDistance(CpuInfo const& a, CpuInfo const& b) {
+        if (a.core == b.core) {
+            return 0;
+        }
+        if (a.llc == b.llc) {
+            return 1;
+        }
+        return a.node == b.node ? 2 : 3;
+    }
+
+    Topology Topology::discover() {
+        Topology topology;
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            spdlog::warn("sched_getaffinity failed, assuming all CPUs are allowed");
+            CPU_ZERO(&allowed);
+            for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency(); cpu++) {
+                CPU_SET(cpu, &allowed);
+            }
+        }
+
+        // sysfs node ids may have holes, they are renumbered in order
+        std::map<int, int> cpu_node;
+        std::map<int, int> node_index;
+        std::error_code ec;
+        for (auto const& entry : std::filesystem::directory_iterator(SYSFS_NODE, ec)) {
+            auto name = entry.path().filename().string();
+            int node = 0;
+            if (!name.starts_with("node") ||
+                std::from_chars(name.data() + 4, name.data() + name.size(), node).ec != std::errc()) {
+                continue;
+            }
+            for (int cpu : parseCpuList(readLine(entry.path() / "cpulist"))) {
+                cpu_node[cpu] = node;
+            }
+            node_index.emplace(node, 0);
+        }
+        int index = 0;
+        for (auto& [node, dense] : node_index) {
+            dense = index++;
+        }
+
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (!CPU_ISSET(cpu, &allowed)) {
+                continue;
+            }
+            auto dir = SYSFS_CPU / ("cpu" + std::to_string(cpu)) / "topology";
+            int core = firstCpu(dir / "core_cpus_list", -1);
+            if (core < 0) {
+                core = firstCpu(dir / "thread_siblings_list", cpu);
+            }
+            auto node = cpu_node.find(cpu);
+            topology.cpus_.push_back({
+                .cpu = cpu,
+                .core = core,
+                .llc = lastLevelCache(cpu, -1),
+                .node = node == cpu_node.end() ? 0 : node_index[node->second],
+            });
+        }
+        topology.nr_nodes_ = std::max(1, index);
+        spdlog::debug("topology: {} CPUs, {} NUMA nodes", topology.cpus_.size(), topology.nr_nodes_);
+        return topology;
+    }
+
+    std::vector<CpuInfo> Topology::place(std::size_t n) const {
+        // rank of a CPU among the SMT siblings of its core
+        std::map<int, int> siblings;
+        std::vector<std::pair<int, CpuInfo>> ranked;
+        for (auto const& cpu : cpus_) {
+            ranked.emplace_back(siblings[cpu.core]++, cpu);
+        }
+        std::sort(ranked.begin(), ranked.end(), [](auto const& a, auto const& b) {
+            return std::tie(a.second.node, a.first, a.second.llc, a.second.core) <
+                   std::tie(b.second.node, b.first, b.second.llc, b.second.core);
+        });
+
+        std::vector<CpuInfo> placement;
+        for (std::size_t i = 0; i < n && !ranked.empty(); i++) {
+            placement.push_back(ranked[i % ranked.size()].second);
+        }
+        return placement;
+    }
+
+} // namespace sylar
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace sylar {
+    // where a CPU sits in the cache and memory hierarchy, a group is identified by its first CPU
+    struct CpuInfo {
+        int cpu;
+        // SMT siblings share the core
+        int core;
+        // CPUs sharing the last level cache
+        int llc;
+        // NUMA node, numbered from 0 without holes
+        int node;
+    };
+
+    // 0 for SMT siblings, 1 for a shared last level cache, 2 for the same NUMA node, 3 for remote
+    int cpuDistance(CpuInfo const& a, CpuInfo const& b);
+
+    // CPU topology from sysfs, restricted to the CPUs the process may run on
+    class Topology {
+    public:
+        static constexpr int MAX_DISTANCE = 3;
+
+        // without sysfs every CPU is a core of its own on a single node sharing one cache
+        static Topology discover();
+
+        std::vector<CpuInfo> const& cpus() const { return cpus_; }
+        int nodeCount() const { return nr_nodes_; }
+
+        // CPUs for n threads: the first thread of every core of a node, then their SMT siblings, then the next node,
+        // wrapping around if there are more threads than CPUs
+        std::vector<CpuInfo> place(std::size_t n) const;
+
+    private:
+        std::vector<CpuInfo> cpus_;
+        int nr_nodes_{1};
+    };
+
+    // "0-3,8,10-11" as in sysfs and cpusets
+    std::vector<int> parseCpuList(std::string_view list);
+
+} // namespace sylar
@@ -8,40 +8,85 @@
 #include <fcntl.h>
 #include <filesystem>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <span>
 #include <utility>
 
 namespace sylar {
+    // A file owns a plain fd, a slot of the registered file table of the processor owner_, or both.
+    // Ops on the owner submit the slot with IOSQE_FIXED_FILE and skip the fget/fput of the fd, a file without a
+    // plain fd (accepted or opened direct) can only be used on its owner.
     struct [[nodiscard]] FileHandle {
+        struct UringFd {
+            int fd_;
+            bool fixed_;
+        };
+
         FileHandle() noexcept = default;
 
         explicit FileHandle(int fileNo) noexcept : fd_(fileNo) {}
+        FileHandle(int fileNo, int fixedIndex, uint64_t owner) noexcept
+            : fd_(fileNo), fixed_(fixedIndex), owner_(owner) {}
 
         int fileNo() const noexcept { return fd_; }
+        bool isFixed() const noexcept { return fixed_ >= 0; }
+        int fixedIndex() const noexcept { return fixed_; }
+        uint64_t owner() const noexcept { return owner_; }
+
+        // the fd to submit on the current processor, moves the fiber to the owner if there is no plain fd
+        UringFd uringFd() {
+            if (fixed_ >= 0) {
+                if (fd_ < 0) {
+                    Processor::switchTo(owner_);
+                }
+                if (Processor::getProcessor() != nullptr && Processor::getProcessorID() == owner_) {
+                    return {fixed_, true};
+                }
+            }
+            return {fd_, false};
+        }
 
         int releaseFile() noexcept { return std::exchange(fd_, -1); }
+        int releaseFixed() noexcept { return std::exchange(fixed_, -1); }
 
-        explicit operator bool() const noexcept { return fd_ > 0; }
+        explicit operator bool() const noexcept { return fd_ > 0 || fixed_ >= 0; }
 
-        FileHandle(FileHandle&& that) noexcept : fd_(that.releaseFile()) {}
+        FileHandle(FileHandle&& that) noexcept
+            : fd_(that.releaseFile()), fixed_(that.releaseFixed()), owner_(that.owner_) {}
 
         FileHandle& operator=(FileHandle&& that) noexcept {
             std::swap(fd_, that.fd_);
+            std::swap(fixed_, that.fixed_);
+            std::swap(owner_, that.owner_);
             return *this;
         }
 
         ~FileHandle() {
+            if (fixed_ >= 0) {
+                Processor::unregisterFile(owner_, static_cast<unsigned>(fixed_));
+            }
             if (fd_ > 0) {
                 close(fd_);
             }
         }
 
     protected:
+        friend void file_register(FileHandle& file);
+        friend int file_install(FileHandle& file);
+
         int fd_{-1};
+        int fixed_{-1};
+        uint64_t owner_{};
     };
 
+    // whether new files of the current processor go into its registered file table
+    inline bool useFixedFiles() {
+        auto* processor = Processor::getProcessor();
+        return processor != nullptr && processor->hasFixedFiles();
+    }
+
     template <int fd>
     FileHandle& stdFileHandle() {
         static FileHandle handle(fd);
@@ -60,25 +105,83 @@ namespace sylar {
 
     inline FileHandle file_open(const std::filesystem::path& path, OpenMode mode, mode_t access = 0644) {
         int flags = static_cast<int>(mode);
+        if (useFixedFiles()) {
+            auto owner = Processor::getProcessorID();
+            int index =
+                UringOp().prep_openat_direct(AT_FDCWD, path.c_str(), flags, access, IORING_FILE_INDEX_ALLOC).await();
+            // the table is full, fall back to a plain fd
+            if (index != -ENFILE) {
+                checkRetUring(index);
+                return FileHandle(-1, index, owner);
+            }
+        }
         int fd = UringOp().prep_openat(AT_FDCWD, path.c_str(), flags, access).await();
         checkRetUring(fd);
         return FileHandle(fd);
     }
 
-    inline void file_close(FileHandle file) { checkRetUring(UringOp().prep_close(file.releaseFile()).await()); }
+    inline void file_close(FileHandle file) {
+        if (file.isFixed()) {
+            Processor::switchTo(file.owner());
+            checkRetUring(UringOp().prep_close_direct(static_cast<unsigned int>(file.releaseFixed())).await());
+            if (file.fileNo() < 0) {
+                return;
+            }
+        }
+        checkRetUring(UringOp().prep_close(file.releaseFile()).await());
+    }
+
+    // put the plain fd of file into the registered file table of the current processor as well
+    inline void file_register(FileHandle& file) {
+        assertThat(!file.isFixed() && file.fileNo() >= 0, "file is already registered");
+        auto owner = Processor::getProcessorID();
+        int index = file.fileNo();
+        checkRetUring(UringOp().prep_files_update(&index, 1, IORING_FILE_INDEX_ALLOC).await());
+        file.fixed_ = index;
+        file.owner_ = owner;
+    }
+
+    // get a plain fd for a file which only lives in a registered file table, e.g. for getsockopt
+    inline int file_install(FileHandle& file) {
+        if (file.fd_ < 0 && file.isFixed()) {
+            Processor::switchTo(file.owner());
+            file.fd_ = checkRetUring(UringOp().prep_fixed_fd_install(file.fixed_, 0).await());
+        }
+        return file.fd_;
+    }
 
     inline int file_read(FileHandle& file, std::span<char> buffer, uint64_t offset = static_cast<uint64_t>(-1)) {
-        return checkRetUring(
-            UringOp()
-                .prep_read(file.fileNo(), buffer.data(), static_cast<unsigned int>(buffer.size()), offset)
-                .await());
+        auto fd = file.uringFd();
+        return checkRetUring(UringOp()
+                                 .prep_read(fd.fd_, buffer.data(), static_cast<unsigned int>(buffer.size()), offset)
+                                 .fixed_file(fd.fixed_)
+                                 .await());
     }
 
     inline int file_write(FileHandle& file, std::span<char const> buffer, uint64_t offset = static_cast<uint64_t>(-1)) {
-        return checkRetUring(
-            UringOp()
-                .prep_write(file.fileNo(), buffer.data(), static_cast<unsigned int>(buffer.size()), offset)
-                .await());
+        auto fd = file.uringFd();
+        return checkRetUring(UringOp()
+                                 .prep_write(fd.fd_, buffer.data(), static_cast<unsigned int>(buffer.size()), offset)
+                                 .fixed_file(fd.fixed_)
+                                 .await());
+    }
+
+    inline int file_readv(FileHandle& file, std::span<struct iovec const> iov,
+                          uint64_t offset = static_cast<uint64_t>(-1)) {
+        auto fd = file.uringFd();
+        return checkRetUring(UringOp()
+                                 .prep_readv(fd.fd_, iov.data(), static_cast<unsigned int>(iov.size()), offset)
+                                 .fixed_file(fd.fixed_)
+                                 .await());
+    }
+
+    inline int file_writev(FileHandle& file, std::span<struct iovec const> iov,
+                           uint64_t offset = static_cast<uint64_t>(-1)) {
+        auto fd = file.uringFd();
+        return checkRetUring(UringOp()
+                                 .prep_writev(fd.fd_, iov.data(), static_cast<unsigned int>(iov.size()), offset)
+                                 .fixed_file(fd.fixed_)
+                                 .await());
     }
 
 } // namespace sylar
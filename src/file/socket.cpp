@@ -1,10 +1,13 @@
 #include "socket.h"
+#include "io_context.h"
 #include "util.h"
 
+#include <linux/filter.h>
 #include <netdb.h>
 #include <optional>
 #include <spdlog/spdlog.h>
 #include <sys/socket.h>
+#include <vector>
 
 namespace sylar {
     std::optional<AddressResolver::ResolveResult> AddressResolver::resolve_all() {
@@ -84,12 +87,12 @@ namespace sylar {
 
     SocketAddress getSockAddr(SocketHandle& sock) {
         SocketAddress addr;
-        checkRet(getsockname(sock.fileNo(), addr.raw_addr(), &addr.len_));
+        checkRet(getsockname(file_install(sock), addr.raw_addr(), &addr.len_));
         return addr;
     }
     SocketAddress getPeerAddr(SocketHandle& sock) {
         SocketAddress addr;
-        checkRet(getpeername(sock.fileNo(), addr.raw_addr(), &addr.len_));
+        checkRet(getpeername(file_install(sock), addr.raw_addr(), &addr.len_));
         return addr;
     }
 
@@ -114,11 +117,329 @@ namespace sylar {
         return serv;
     }
     SocketHandle socket_accept(SocketListener& listener) {
-        int fd = UringOp().prep_accept(listener.fileNo(), nullptr, nullptr, 0).await();
+        if (listener.multishot_) {
+            return listener.multishot_->accept(listener);
+        }
+        auto listen_fd = listener.uringFd();
+        if (useFixedFiles()) {
+            auto owner = Processor::getProcessorID();
+            int index = UringOp()
+                            .prep_accept_direct(listen_fd.fd_, nullptr, nullptr, 0, IORING_FILE_INDEX_ALLOC)
+                            .fixed_file(listen_fd.fixed_)
+                            .await();
+            // the table is full, fall back to a plain fd
+            if (index != -ENFILE) {
+                checkRetUring(index);
+                return SocketHandle{-1, index, owner};
+            }
+            listen_fd = listener.uringFd();
+        }
+        int fd = UringOp().prep_accept(listen_fd.fd_, nullptr, nullptr, 0).fixed_file(listen_fd.fixed_).await();
         checkRetUring(fd);
         return SocketHandle{fd};
     }
 
+    SocketHandle MultishotAccept::accept(SocketListener& listener) {
+        while (true) {
+            if (owner_) {
+                Processor::switchTo(*owner_);
+            }
+            if (!results_.empty()) {
+                int res = results_.front();
+                results_.pop();
+                return toHandle(checkRetUring(res));
+            }
+            if (!armed_) {
+                arm(listener);
+            }
+            wait();
+        }
+    }
+
+    bool MultishotAccept::stop() {
+        if (!owner_) {
+            return true;
+        }
+        auto* processor = Processor::getProcessor();
+        if (processor == nullptr || Fiber::getCurrentFiber() == Processor::getProcessorFiber()) {
+            return processor != nullptr && Processor::getProcessorID() == *owner_ && !armed_;
+        }
+
+        Processor::switchTo(*owner_);
+        if (armed_) {
+            (void)UringOp().prep_cancel64(Processor::getUserData(this), 0).await();
+            while (true) {
+                Processor::switchTo(*owner_);
+                if (!armed_) {
+                    break;
+                }
+                wait();
+            }
+        }
+        // close the connections nobody accepted
+        while (!results_.empty()) {
+            if (results_.front() >= 0) {
+                (void)toHandle(results_.front());
+            }
+            results_.pop();
+        }
+        return true;
+    }
+
+    void MultishotAccept::complete(struct io_uring_cqe const* cqe) {
+        bool more = cqe->flags & IORING_CQE_F_MORE;
+        if (!more) {
+            armed_ = false;
+        }
+        if (cqe->res != -ECANCELED) {
+            results_.push(cqe->res);
+        }
+
+        // a connection for one waiter, or re-arm by anyone once the accept is dropped
+        auto* processor = Processor::getProcessor();
+        while (!waiters_.empty()) {
+            processor->emplaceTask(waiters_.front());
+            waiters_.pop();
+            if (more) {
+                break;
+            }
+        }
+    }
+
+    void MultishotAccept::arm(SocketListener& listener) {
+        // the listener may have to move us to its owner first
+        auto fd = listener.uringFd();
+        auto* processor = Processor::getProcessor();
+        if (!owner_) {
+            owner_ = Processor::getProcessorID();
+            fixed_ = processor->hasFixedFiles();
+        }
+
+        struct io_uring_sqe* sqe = processor->getSqe(this);
+        if (fixed_) {
+            io_uring_prep_multishot_accept_direct(sqe, fd.fd_, nullptr, nullptr, 0);
+        } else {
+            io_uring_prep_multishot_accept(sqe, fd.fd_, nullptr, nullptr, 0);
+        }
+        if (fd.fixed_) {
+            sqe->flags |= IOSQE_FIXED_FILE;
+        }
+        armed_ = true;
+    }
+
+    void MultishotAccept::wait() {
+        waiters_.push(Fiber::getCurrentFiber());
+        Fiber::yield();
+    }
+
+    SocketHandle MultishotAccept::toHandle(int res) const {
+        if (fixed_) {
+            return SocketHandle{-1, res, *owner_};
+        }
+        return SocketHandle{res};
+    }
+
+    int socket_readv(SocketHandle& sock, std::span<struct iovec const> iov, UringOp::timeout_type timeout) {
+        auto fd = sock.uringFd();
+        struct msghdr msg{};
+        msg.msg_iov = const_cast<struct iovec*>(iov.data());
+        msg.msg_iovlen = iov.size();
+        return checkRetUring(UringOp(timeout).prep_recvmsg(fd.fd_, &msg, 0).fixed_file(fd.fixed_).await());
+    }
+    int socket_writev(SocketHandle& sock, std::span<struct iovec const> iov, UringOp::timeout_type timeout) {
+        auto fd = sock.uringFd();
+        struct msghdr msg{};
+        msg.msg_iov = const_cast<struct iovec*>(iov.data());
+        msg.msg_iovlen = iov.size();
+        return checkRetUring(UringOp(timeout).prep_sendmsg(fd.fd_, &msg, MSG_NOSIGNAL).fixed_file(fd.fixed_).await());
+    }
+
+    int socket_send_zc(SocketHandle& sock, std::span<char const> buffer, UringOp::timeout_type timeout) {
+        if (buffer.size() < IOContext::getInstance()->getOptions().send_zc_threshold) {
+            return socket_write(sock, buffer, timeout);
+        }
+        auto fd = sock.uringFd();
+        return checkRetUring(UringOp(timeout)
+                                 .prep_send_zc(fd.fd_, buffer.data(), buffer.size(), MSG_NOSIGNAL)
+                                 .fixed_file(fd.fixed_)
+                                 .await());
+    }
+
+    std::size_t transfer(FileHandle& file, SocketHandle& sock, uint64_t offset, std::size_t len) {
+        // the fds of both ends on the current processor, the fiber may move between two chunks
+        auto uringFds = [&]() {
+            auto out = sock.uringFd();
+            auto in = file.uringFd();
+            if (out.fixed_ && Processor::getProcessorID() != sock.owner()) {
+                // moved to the owner of file
+                assertThat(sock.fileNo() >= 0, "file and socket are registered on different processors");
+                out = {sock.fileNo(), false};
+            }
+            return std::pair{in, out};
+        };
+
+        auto pipe = Processor::getProcessor()->acquirePipe();
+        std::size_t sent = 0;
+        while (sent < len) {
+            auto chunk = static_cast<unsigned int>(std::min<std::size_t>(len - sent, pipe.size()));
+            auto [in, out] = uringFds();
+            // getting an SQE may submit the ones taken before, so each op is prepared before the next one is taken
+            UringOp to_pipe;
+            static_cast<void>(std::move(to_pipe)
+                                  .prep_splice(in.fd_, static_cast<int64_t>(offset + sent), pipe.writeFd(), -1, chunk,
+                                               in.fixed_ ? SPLICE_F_FD_IN_FIXED : 0)
+                                  .link());
+            UringOp to_sock;
+            static_cast<void>(
+                std::move(to_sock).prep_splice(pipe.readFd(), -1, out.fd_, -1, chunk, 0).fixed_file(out.fixed_));
+            int spliced = std::move(to_pipe).await();
+            int drained = std::move(to_sock).await();
+            // the pipe is dropped if it throws, it may still hold data
+            checkRetUring(spliced);
+            if (spliced == 0) {
+                break;
+            }
+            // a short splice into the pipe cancels the linked one, a short one out of it leaves data behind
+            auto buffered = static_cast<unsigned int>(spliced);
+            if (drained != -ECANCELED) {
+                buffered -= static_cast<unsigned int>(checkRetUring(drained));
+            }
+            while (buffered > 0) {
+                out = uringFds().second;
+                buffered -= static_cast<unsigned int>(checkRetUring(
+                    UringOp().prep_splice(pipe.readFd(), -1, out.fd_, -1, buffered, 0).fixed_file(out.fixed_).await()));
+            }
+            sent += static_cast<std::size_t>(spliced);
+        }
+        Processor::getProcessor()->releasePipe(std::move(pipe));
+        return sent;
+    }
+
+    std::span<char const> MultishotRecv::recv(SocketHandle& sock, UringOp::timeout_type timeout) {
+        if (owner_) {
+            Processor::switchTo(*owner_);
+        }
+        release();
+        while (true) {
+            if (!results_.empty()) {
+                auto result = results_.front();
+                results_.pop();
+                auto* ring = Processor::getProcessor()->getBufferRing();
+                if (result.res_ == -ENOBUFS) {
+                    // the kernel dropped the recv, it is armed again by the next recv
+                    fallback_.resize(ring->bufferSize());
+                    auto n = socket_read(sock, fallback_, timeout);
+                    return {fallback_.data(), static_cast<std::size_t>(n)};
+                }
+                checkRetUring(result.res_);
+                if (result.res_ == 0) {
+                    return {};
+                }
+                current_ = result.bid_;
+                return ring->buffer(result.bid_, static_cast<std::size_t>(result.res_));
+            }
+            if (!armed_) {
+                arm(sock);
+            }
+            wait(timeout);
+        }
+    }
+
+    bool MultishotRecv::stop() {
+        if (!owner_) {
+            return true;
+        }
+        auto* processor = Processor::getProcessor();
+        if (processor == nullptr || Fiber::getCurrentFiber() == Processor::getProcessorFiber()) {
+            if (processor == nullptr || Processor::getProcessorID() != *owner_ || armed_) {
+                return false;
+            }
+        } else {
+            Processor::switchTo(*owner_);
+            if (armed_) {
+                (void)UringOp().prep_cancel64(Processor::getUserData(this), 0).await();
+                while (armed_) {
+                    wait(std::nullopt);
+                }
+            }
+        }
+
+        release();
+        auto* ring = Processor::getProcessor()->getBufferRing();
+        while (!results_.empty()) {
+            if (results_.front().res_ > 0) {
+                ring->release(results_.front().bid_);
+            }
+            results_.pop();
+        }
+        return true;
+    }
+
+    void MultishotRecv::complete(struct io_uring_cqe const* cqe) {
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            armed_ = false;
+        }
+        if (cqe->res != -ECANCELED) {
+            results_.push({cqe->res, static_cast<uint16_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT)});
+        }
+        if (waiter_ != nullptr) {
+            Processor::getProcessor()->emplaceTask(std::exchange(waiter_, nullptr));
+        }
+    }
+
+    void MultishotRecv::arm(SocketHandle& sock) {
+        // the socket may have to move us to its owner first
+        auto fd = sock.uringFd();
+        auto* processor = Processor::getProcessor();
+        if (!owner_) {
+            owner_ = Processor::getProcessorID();
+        }
+
+        struct io_uring_sqe* sqe = processor->getSqe(this);
+        io_uring_prep_recv_multishot(sqe, fd.fd_, nullptr, 0, 0);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        if (fd.fixed_) {
+            sqe->flags |= IOSQE_FIXED_FILE;
+        }
+        sqe->buf_group = processor->getBufferRing()->group();
+        armed_ = true;
+    }
+
+    void MultishotRecv::wait(UringOp::timeout_type timeout) {
+        auto* fiber = Fiber::getCurrentFiber();
+        waiter_ = fiber;
+        if (!timeout) {
+            Fiber::yield();
+            Processor::switchTo(*owner_);
+            return;
+        }
+
+        // the timer runs on this processor as well, it wakes us up unless a CQE did
+        auto seq = ++wait_seq_;
+        timed_out_ = false;
+        auto timer = Processor::getProcessor()->addTimer(*timeout, [this, fiber, seq]() {
+            if (waiter_ == fiber && wait_seq_ == seq) {
+                waiter_ = nullptr;
+                timed_out_ = true;
+                Processor::getProcessor()->emplaceTask(fiber);
+            }
+        });
+        Fiber::yield();
+        Processor::switchTo(*owner_);
+        timer.cancel();
+        if (timed_out_) {
+            // the same error as a read cancelled by its linked timeout
+            checkRetUring(-ECANCELED);
+        }
+    }
+
+    void MultishotRecv::release() {
+        if (current_) {
+            Processor::getProcessor()->getBufferRing()->release(*current_);
+            current_.reset();
+        }
+    }
+
     SocketHandle socket_connect(SocketAddress const& addr) {
         SocketHandle sock = createSocket(addr.family(), addr.socktype(), addr.protocol());
         checkRetUring(UringOp().prep_connect(sock.fileNo(), addr.raw_addr(), addr.len_).await());
@@ -126,14 +447,80 @@ namespace sylar {
     }
 
     int socket_read(SocketHandle& sock, std::span<char> buffer, UringOp::timeout_type timeout) {
+        auto fd = sock.uringFd();
         return checkRetUring(UringOp(timeout)
-                                 .prep_read(sock.fileNo(), buffer.data(), static_cast<unsigned int>(buffer.size()), 0)
+                                 .prep_read(fd.fd_, buffer.data(), static_cast<unsigned int>(buffer.size()), 0)
+                                 .fixed_file(fd.fixed_)
                                  .await());
     }
     int socket_write(SocketHandle& sock, std::span<char const> buffer, UringOp::timeout_type timeout) {
+        auto fd = sock.uringFd();
         return checkRetUring(UringOp(timeout)
-                                 .prep_write(sock.fileNo(), buffer.data(), static_cast<unsigned int>(buffer.size()), 0)
+                                 .prep_write(fd.fd_, buffer.data(), static_cast<unsigned int>(buffer.size()), 0)
+                                 .fixed_file(fd.fixed_)
                                  .await());
     }
 
+    namespace {
+        // The reuseport group picks the socket of the processor pinned to the CPU, the sockets joined the group in
+        // processor order. CBPF has no maps, the CPU is compared with the CPU of each processor in turn, a CPU
+        // without a processor falls back to socket (cpu % nr_sockets).
+        void attachSteering(SocketListener& listener, std::vector<CpuInfo> const& placement) {
+            std::vector<struct sock_filter> code;
+            code.push_back({BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)});
+            for (std::size_t i = 0; i < placement.size(); i++) {
+                // on a match fall through to the return, otherwise skip it
+                code.push_back({BPF_JMP | BPF_JEQ | BPF_K, 0, 1, static_cast<uint32_t>(placement[i].cpu)});
+                code.push_back({BPF_RET | BPF_K, 0, 0, static_cast<uint32_t>(i)});
+            }
+            code.push_back({BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<uint32_t>(placement.size())});
+            code.push_back({BPF_RET | BPF_A, 0, 0, 0});
+            assertThat(code.size() <= BPF_MAXINSNS, "too many processors for the steering program");
+            struct sock_fprog prog{static_cast<unsigned short>(code.size()), code.data()};
+            checkRet(setsockopt(listener.fileNo(), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)));
+        }
+    } // namespace
+
+    void socket_listen_sharded(SocketAddress const& addr, std::function<void(SocketHandle)> handler,
+                               ShardedListenOptions const& options) {
+        auto* context = IOContext::getInstance();
+        auto nr_processors = context->getProcessorCount();
+        // a processor only sticks to a CPU when pinned
+        auto const& placement = context->getPlacement();
+        assertThat(placement.size() == nr_processors || !(options.incoming_cpu || options.steering),
+                   "incoming_cpu and steering need pin_threads");
+        int on = 1;
+        std::vector<std::shared_ptr<SocketListener>> listeners;
+        for (std::size_t i = 0; i < nr_processors; i++) {
+            auto sock = createSocket(addr.family(), addr.socktype(), addr.protocol());
+            checkRet(setsockopt(sock.fileNo(), SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)));
+            if (options.incoming_cpu) {
+                int cpu = placement[i].cpu;
+                checkRet(setsockopt(sock.fileNo(), SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)));
+            }
+            checkRet(bind(sock.fileNo(), addr.raw_addr(), addr.len_));
+            listeners.push_back(std::make_shared<SocketListener>(socket_listen(std::move(sock), options.backlog)));
+        }
+        if (options.steering) {
+            attachSteering(*listeners.front(), placement);
+        }
+
+        for (std::size_t i = 0; i < nr_processors; i++) {
+            IOContext::spawnOn(i, [listener = listeners[i], handler, multishot = options.multishot]() {
+                if (multishot) {
+                    listener->enableMultishot();
+                }
+                while (true) {
+                    try {
+                        auto sock = std::make_shared<SocketHandle>(socket_accept(*listener));
+                        IOContext::spawnOn(Processor::getProcessorID(),
+                                           [handler, sock]() { handler(std::move(*sock)); });
+                    } catch (std::system_error& ex) {
+                        spdlog::error("Processor {}: accept: {}", Processor::getProcessorID(), ex.what());
+                    }
+                }
+            });
+        }
+    }
+
 } // namespace sylar
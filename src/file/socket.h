@@ -7,7 +7,11 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#include <functional>
+#include <memory>
+#include <queue>
 #include <string>
+#include <vector>
 
 namespace sylar {
     struct SocketAddress {
@@ -77,8 +81,98 @@ namespace sylar {
         using FileHandle::FileHandle;
     };
 
+    struct SocketListener;
+
+    // Accepts the connections of a listener with a single multishot accept, which is only re-armed once the kernel
+    // drops it (a CQE without IORING_CQE_F_MORE). Connections queue up on the processor which armed it, accept()
+    // moves the calling fiber there.
+    struct MultishotAccept : UringHandler {
+        MultishotAccept() = default;
+        MultishotAccept(MultishotAccept&&) = delete;
+
+        SocketHandle accept(SocketListener& listener);
+        // cancel the accept and wait for its last CQE, false if it can't wait outside of a fiber
+        bool stop();
+
+    private:
+        void complete(struct io_uring_cqe const* cqe) override;
+        void arm(SocketListener& listener);
+        void wait();
+        SocketHandle toHandle(int res) const;
+
+        // the processor which armed the accept, only its thread touches the fields below
+        std::optional<uint64_t> owner_;
+        bool armed_{false};
+        bool fixed_{false};
+        // accepted fds (or table slots with fixed_), negative errno on errors
+        std::queue<int> results_;
+        std::queue<Fiber*> waiters_;
+    };
+
+    // Receives with a multishot recv into the provided buffers of the processor which armed it, so a buffer is
+    // only taken when data arrives. Like MultishotAccept, received buffers queue up on that processor and recv()
+    // moves the calling fiber there. A single fiber may receive at a time.
+    struct MultishotRecv : UringHandler {
+        MultishotRecv() = default;
+        MultishotRecv(MultishotRecv&&) = delete;
+
+        // Give the previous buffer back and wait for the next one, empty at EOF. The data is read the plain way
+        // when the processor runs out of provided buffers.
+        std::span<char const> recv(SocketHandle& sock, UringOp::timeout_type timeout = std::nullopt);
+        // cancel the recv, wait for its last CQE and give the buffers back, false if it can't outside of a fiber
+        bool stop();
+
+    private:
+        struct Result {
+            int res_;
+            uint16_t bid_;
+        };
+
+        void complete(struct io_uring_cqe const* cqe) override;
+        void arm(SocketHandle& sock);
+        void wait(UringOp::timeout_type timeout);
+        void release();
+
+        // the processor which armed the recv, only its thread touches the fields below
+        std::optional<uint64_t> owner_;
+        bool armed_{false};
+        std::queue<Result> results_;
+        std::optional<uint16_t> current_;
+        Fiber* waiter_{};
+        // tells a late timer of an earlier wait apart
+        uint64_t wait_seq_{};
+        bool timed_out_{false};
+        std::vector<char> fallback_;
+    };
+
     struct [[nodiscard]] SocketListener : SocketHandle {
         using SocketHandle::SocketHandle;
+
+        SocketListener(SocketListener&&) noexcept = default;
+        SocketListener& operator=(SocketListener&& that) noexcept {
+            SocketHandle::operator=(std::move(that));
+            std::swap(multishot_, that.multishot_);
+            return *this;
+        }
+        ~SocketListener() {
+            // the handler can't be freed while the kernel may still complete into it
+            if (multishot_ && !multishot_->stop()) {
+                spdlog::warn("multishot accept is still armed, leaking it");
+                (void)multishot_.release();
+            }
+        }
+
+        // accept connections with a multishot accept from now on
+        void enableMultishot() {
+            if (!multishot_) {
+                multishot_ = std::make_unique<MultishotAccept>();
+            }
+        }
+
+    private:
+        friend SocketHandle socket_accept(SocketListener& listener);
+
+        std::unique_ptr<MultishotAccept> multishot_;
     };
 
     SocketAddress getSockAddr(SocketHandle& sock);
@@ -94,7 +188,38 @@ namespace sylar {
 
     SocketHandle socket_connect(SocketAddress const& addr);
 
+    struct ShardedListenOptions {
+        int backlog = SOMAXCONN;
+        // accept with MultishotAccept
+        bool multishot = false;
+        // SO_INCOMING_CPU of the listener of a processor is the CPU it is pinned to, needs pin_threads
+        bool incoming_cpu = false;
+        // steer a connection to the listener of the processor pinned to the CPU which received it, with a CBPF
+        // program attached by SO_ATTACH_REUSEPORT_CBPF, needs pin_threads
+        bool steering = false;
+    };
+
+    // Bind one SO_REUSEPORT listener per processor, each one accepted by a fiber pinned to its processor, so the
+    // kernel spreads new connections over the rings. handler runs in a fiber pinned to the processor which accepted
+    // the connection, no connection is handed over to another core. Returns once all listeners are bound.
+    void socket_listen_sharded(SocketAddress const& addr, std::function<void(SocketHandle)> handler,
+                               ShardedListenOptions const& options = {});
+
     int socket_read(SocketHandle& sock, std::span<char> buffer, UringOp::timeout_type timeout = std::nullopt);
     int socket_write(SocketHandle& sock, std::span<char const> buffer, UringOp::timeout_type timeout = std::nullopt);
+    // scatter/gather, the iovecs must stay valid until it returns
+    int socket_readv(SocketHandle& sock, std::span<struct iovec const> iov,
+                     UringOp::timeout_type timeout = std::nullopt);
+    int socket_writev(SocketHandle& sock, std::span<struct iovec const> iov,
+                      UringOp::timeout_type timeout = std::nullopt);
+    // Send without copying buffer into the kernel (IORING_OP_SEND_ZC), returns once the kernel released buffer.
+    // Buffers below IOContextOptions::send_zc_threshold are sent with a copy.
+    int socket_send_zc(SocketHandle& sock, std::span<char const> buffer, UringOp::timeout_type timeout = std::nullopt);
+
+    // Send len bytes of file from offset to sock without copying them through user space: each chunk is spliced
+    // into a pipe cached by the processor and out of it by two linked IORING_OP_SPLICE. Returns the bytes sent,
+    // less than len if the file ends before. A file and a socket only living in registered file tables must share
+    // their owner.
+    std::size_t transfer(FileHandle& file, SocketHandle& sock, uint64_t offset, std::size_t len);
 
 } // namespace sylar
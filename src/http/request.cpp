@@ -0,0 +1,185 @@
+#include "request.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace sylar::http {
+    namespace {
+        // first c in [p, end), end if there is none, 16 bytes at a time with SSE2
+        char const* findChar(char const* p, char const* end, char c) noexcept {
+#ifdef __SSE2__
+            auto needle = _mm_set1_epi8(c);
+            while (end - p >= 16) {
+                auto chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+                auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+                if (mask != 0) {
+                    return p + std::countr_zero(mask);
+                }
+                p += 16;
+            }
+#endif
+            auto const* found = static_cast<char const*>(std::memchr(p, c, static_cast<std::size_t>(end - p)));
+            return found != nullptr ? found : end;
+        }
+
+        char toLower(char c) noexcept { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; }
+
+        bool isSpace(char c) noexcept { return c == ' ' || c == '\t'; }
+
+        std::string_view trim(std::string_view s) noexcept {
+            while (!s.empty() && isSpace(s.front())) {
+                s.remove_prefix(1);
+            }
+            while (!s.empty() && isSpace(s.back())) {
+                s.remove_suffix(1);
+            }
+            return s;
+        }
+
+        // whether the comma separated list s has token, e.g. Connection: keep-alive, Upgrade
+        bool hasToken(std::string_view s, std::string_view token) noexcept {
+            while (!s.empty()) {
+                auto pos = s.find(',');
+                if (equalsIgnoreCase(trim(s.substr(0, pos)), token)) {
+                    return true;
+                }
+                if (pos == std::string_view::npos) {
+                    break;
+                }
+                s.remove_prefix(pos + 1);
+            }
+            return false;
+        }
+    } // namespace
+
+    bool equalsIgnoreCase(std::string_view a, std::string_view b) noexcept {
+        return a.size() == b.size() &&
+               std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) { return toLower(x) == toLower(y); });
+    }
+
+    std::optional<std::string_view> Headers::get(std::string_view name) const noexcept {
+        for (auto const& header : *this) {
+            if (equalsIgnoreCase(header.name, name)) {
+                return header.value;
+            }
+        }
+        return std::nullopt;
+    }
+
+    ParseStatus RequestParser::parse(std::span<char const> buffer, Request& request) {
+        auto const* begin = buffer.data();
+        auto const* end = begin + buffer.size();
+
+        if (head_size_ == 0) {
+            // the head ends with an empty line, look for the LF of its CRLF
+            auto const* p = begin + scanned_;
+            while (true) {
+                p = findChar(p, end, '\n');
+                if (p == end) {
+                    scanned_ = buffer.size();
+                    return scanned_ > max_head_size_ ? fail(431) : ParseStatus::Incomplete;
+                }
+                if (p - begin >= 3 && p[-1] == '\r' && p[-2] == '\n' && p[-3] == '\r') {
+                    break;
+                }
+                ++p;
+            }
+            head_size_ = static_cast<std::size_t>(p + 1 - begin);
+            if (head_size_ > max_head_size_) {
+                return fail(431);
+            }
+        }
+
+        // the views are taken again on every call, the buffer may have moved since the previous one
+        if (auto status = parseHead(begin, request); status != ParseStatus::Complete) {
+            return status;
+        }
+        if (buffer.size() < head_size_ + body_size_) {
+            return ParseStatus::Incomplete;
+        }
+        request.body = {begin + head_size_, body_size_};
+        return ParseStatus::Complete;
+    }
+
+    ParseStatus RequestParser::parseHead(char const* begin, Request& request) {
+        auto const* end = begin + head_size_;
+        request.headers.clear();
+
+        // request-line = method SP request-target SP HTTP-version CRLF
+        auto const* eol = findChar(begin, end, '\n');
+        auto line = std::string_view(begin, static_cast<std::size_t>(eol - begin));
+        if (line.empty() || line.back() != '\r') {
+            return fail(400);
+        }
+        line.remove_suffix(1);
+        auto sp1 = line.find(' ');
+        auto sp2 = line.find(' ', sp1 + 1);
+        if (sp1 == 0 || sp1 == std::string_view::npos || sp2 == std::string_view::npos || sp2 == sp1 + 1) {
+            return fail(400);
+        }
+        request.method = line.substr(0, sp1);
+        request.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+        auto version = line.substr(sp2 + 1);
+        if (version == "HTTP/1.1") {
+            request.version_minor = 1;
+        } else if (version == "HTTP/1.0") {
+            request.version_minor = 0;
+        } else {
+            return fail(version.starts_with("HTTP/") ? 505 : 400);
+        }
+
+        // field-line = field-name ":" OWS field-value OWS CRLF, up to the empty line
+        std::optional<std::size_t> content_length;
+        bool keep_alive = request.version_minor == 1;
+        for (auto const* p = eol + 1; end - p > 2; p = eol + 1) {
+            eol = findChar(p, end, '\n');
+            line = std::string_view(p, static_cast<std::size_t>(eol - p));
+            if (line.empty() || line.back() != '\r' || isSpace(line.front())) {
+                // obsolete line folding is rejected as well
+                return fail(400);
+            }
+            line.remove_suffix(1);
+            auto colon = line.find(':');
+            if (colon == 0 || colon == std::string_view::npos) {
+                return fail(400);
+            }
+            auto name = line.substr(0, colon);
+            if (std::any_of(name.begin(), name.end(), isSpace)) {
+                return fail(400);
+            }
+            auto value = trim(line.substr(colon + 1));
+            if (!request.headers.add(name, value)) {
+                return fail(431);
+            }
+
+            if (equalsIgnoreCase(name, "Content-Length")) {
+                std::size_t length{};
+                auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+                if (ec != std::errc() || ptr != value.data() + value.size() || value.empty() ||
+                    (content_length && *content_length != length)) {
+                    return fail(400);
+                }
+                content_length = length;
+            } else if (equalsIgnoreCase(name, "Transfer-Encoding")) {
+                // chunked request bodies are not supported
+                return fail(501);
+            } else if (equalsIgnoreCase(name, "Connection")) {
+                keep_alive = request.version_minor == 1 ? !hasToken(value, "close") : hasToken(value, "keep-alive");
+            }
+        }
+
+        body_size_ = content_length.value_or(0);
+        if (body_size_ > max_body_size_) {
+            return fail(413);
+        }
+        request.keep_alive = keep_alive;
+        return ParseStatus::Complete;
+    }
+
+} // namespace sylar::http
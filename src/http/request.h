@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace sylar::http {
+    struct Header {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    // header fields in a fixed array, names and values point into the read buffer
+    class Headers {
+    public:
+        static constexpr std::size_t MAX_HEADERS = 64;
+
+        // value of the first field named name, case-insensitive
+        std::optional<std::string_view> get(std::string_view name) const noexcept;
+        // false if the array is full
+        bool add(std::string_view name, std::string_view value) noexcept {
+            if (size_ == MAX_HEADERS) {
+                return false;
+            }
+            headers_[size_++] = {name, value};
+            return true;
+        }
+        void clear() noexcept { size_ = 0; }
+
+        std::size_t size() const noexcept { return size_; }
+        Header const* begin() const noexcept { return headers_.data(); }
+        Header const* end() const noexcept { return headers_.data() + size_; }
+
+    private:
+        std::array<Header, MAX_HEADERS> headers_;
+        std::size_t size_{};
+    };
+
+    // a parsed request, every view points into the read buffer and is valid until the request is consumed
+    struct Request {
+        std::string_view method;
+        std::string_view target;
+        // 0 for HTTP/1.0, 1 for HTTP/1.1
+        int version_minor{};
+        Headers headers;
+        std::string_view body;
+        bool keep_alive{};
+
+        std::string_view path() const noexcept { return target.substr(0, target.find('?')); }
+        std::string_view query() const noexcept {
+            auto pos = target.find('?');
+            return pos == std::string_view::npos ? std::string_view() : target.substr(pos + 1);
+        }
+    };
+
+    bool equalsIgnoreCase(std::string_view a, std::string_view b) noexcept;
+
+    enum class ParseStatus {
+        Complete,
+        Incomplete,
+        Error,
+    };
+
+    // Incremental request parser working in place on the bytes of the stream, nothing is copied.
+    // The buffer passed to parse starts with the request and grows across calls until it's complete, the scan for
+    // the end of the head resumes where the previous call stopped.
+    class RequestParser {
+    public:
+        explicit RequestParser(std::size_t max_head_size = 8192, std::size_t max_body_size = 1024 * 1024)
+            : max_head_size_(max_head_size), max_body_size_(max_body_size) {}
+
+        ParseStatus parse(std::span<char const> buffer, Request& request);
+
+        // bytes of the complete request, head and body
+        std::size_t consumed() const noexcept { return head_size_ + body_size_; }
+        // the status of the error response
+        int errorStatus() const noexcept { return error_status_; }
+
+        // start over with the next request
+        void reset() noexcept {
+            scanned_ = 0;
+            head_size_ = 0;
+            body_size_ = 0;
+            error_status_ = 0;
+        }
+
+    private:
+        ParseStatus fail(int status) noexcept {
+            error_status_ = status;
+            return ParseStatus::Error;
+        }
+        ParseStatus parseHead(char const* begin, Request& request);
+
+        std::size_t max_head_size_;
+        std::size_t max_body_size_;
+        std::size_t scanned_{};
+        std::size_t head_size_{};
+        std::size_t body_size_{};
+        int error_status_{};
+    };
+
+} // namespace sylar::http
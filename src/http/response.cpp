@@ -0,0 +1,93 @@
+#include "response.h"
+#include "util.h"
+
+#include <charconv>
+
+namespace sylar::http {
+    std::string_view reasonPhrase(int status) noexcept {
+        switch (status) {
+        case 200:
+            return "OK";
+        case 201:
+            return "Created";
+        case 204:
+            return "No Content";
+        case 301:
+            return "Moved Permanently";
+        case 302:
+            return "Found";
+        case 304:
+            return "Not Modified";
+        case 400:
+            return "Bad Request";
+        case 403:
+            return "Forbidden";
+        case 404:
+            return "Not Found";
+        case 405:
+            return "Method Not Allowed";
+        case 413:
+            return "Content Too Large";
+        case 431:
+            return "Request Header Fields Too Large";
+        case 500:
+            return "Internal Server Error";
+        case 501:
+            return "Not Implemented";
+        case 503:
+            return "Service Unavailable";
+        case 505:
+            return "HTTP Version Not Supported";
+        default:
+            return "Unknown";
+        }
+    }
+
+    void ResponseWriter::header(std::string_view name, std::string_view value) {
+        assertThat(nr_headers_ < MAX_HEADERS, "too many response headers");
+        headers_[nr_headers_++] = {name, value};
+    }
+
+    void ResponseWriter::send(int status, std::string_view body, std::string_view content_type) {
+        writeHead(status, body.size(), content_type);
+        stream_.put(body);
+    }
+
+    void ResponseWriter::sendRef(int status, std::span<char const> body, std::string_view content_type) {
+        writeHead(status, body.size(), content_type);
+        stream_.put_ref(body);
+    }
+
+    void ResponseWriter::writeHead(int status, std::size_t content_length, std::string_view content_type) {
+        assertThat(!sent_, "response already sent");
+        sent_ = true;
+
+        // formatted on the stack, the stream copies it into its output buffer
+        char number[24];
+        auto put_number = [&](auto value) {
+            auto [ptr, ec] = std::to_chars(number, number + sizeof(number), value);
+            stream_.put(std::span<char const>(number, ptr));
+        };
+
+        stream_.put(std::string_view("HTTP/1.1 "));
+        put_number(status);
+        stream_.put(' ');
+        stream_.put(reasonPhrase(status));
+        stream_.put(std::string_view("\r\nContent-Type: "));
+        stream_.put(content_type);
+        stream_.put(std::string_view("\r\nContent-Length: "));
+        put_number(content_length);
+        stream_.put(std::string_view("\r\n"));
+        if (!keep_alive_) {
+            stream_.put(std::string_view("Connection: close\r\n"));
+        }
+        for (std::size_t i = 0; i < nr_headers_; i++) {
+            stream_.put(headers_[i].name);
+            stream_.put(std::string_view(": "));
+            stream_.put(headers_[i].value);
+            stream_.put(std::string_view("\r\n"));
+        }
+        stream_.put(std::string_view("\r\n"));
+    }
+
+} // namespace sylar::http
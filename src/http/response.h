@@ -0,0 +1,52 @@
+#pragma once
+
+#include "request.h"
+#include "stream/stream.h"
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+namespace sylar::http {
+    std::string_view reasonPhrase(int status) noexcept;
+
+    // Writes the responses of a connection into the output buffer of its stream, the server flushes them once per
+    // batch of pipelined requests.
+    class ResponseWriter {
+    public:
+        static constexpr std::size_t MAX_HEADERS = 16;
+
+        explicit ResponseWriter(BorrowedStream& stream) : stream_(stream) {}
+
+        // an extra field of the next response, name and value must stay valid until it's sent
+        void header(std::string_view name, std::string_view value);
+
+        // the status line, the headers and a copy of body
+        void send(int status, std::string_view body, std::string_view content_type = "text/plain");
+        // body is not copied, it must stay valid until the batch is flushed
+        void sendRef(int status, std::span<char const> body, std::string_view content_type = "text/plain");
+
+        // the connection is closed after the current response
+        void close() noexcept { keep_alive_ = false; }
+        bool keepAlive() const noexcept { return keep_alive_; }
+        bool sent() const noexcept { return sent_; }
+
+        // get ready for the response to the next request
+        void reset(bool keep_alive) noexcept {
+            keep_alive_ = keep_alive;
+            sent_ = false;
+            nr_headers_ = 0;
+        }
+
+    private:
+        void writeHead(int status, std::size_t content_length, std::string_view content_type);
+
+        BorrowedStream& stream_;
+        std::array<Header, MAX_HEADERS> headers_;
+        std::size_t nr_headers_{};
+        bool keep_alive_{true};
+        bool sent_{false};
+    };
+
+} // namespace sylar::http
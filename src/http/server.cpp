@@ -0,0 +1,70 @@
+#include "server.h"
+#include "io_context.h"
+#include "stream/socket_stream.h"
+
+#include <spdlog/spdlog.h>
+
+namespace sylar::http {
+    void serve_connection(SocketHandle sock, Handler const& handler, ServerOptions const& options) {
+        auto stream = make_stream<SocketStream>(std::move(sock));
+        stream.timeout(options.idle_timeout);
+        RequestParser parser(options.max_head_size, options.max_body_size);
+        ResponseWriter writer(stream);
+        Request request;
+
+        try {
+            while (true) {
+                auto buffer = stream.peek();
+                auto status = buffer.empty() ? ParseStatus::Incomplete : parser.parse(buffer, request);
+
+                if (status == ParseStatus::Complete) {
+                    writer.reset(request.keep_alive);
+                    try {
+                        handler(request, writer);
+                        if (!writer.sent()) {
+                            writer.close();
+                            writer.send(500, "no response\n");
+                        }
+                    } catch (std::exception& ex) {
+                        spdlog::error("http: {} {}: {}", request.method, request.target, ex.what());
+                        if (!writer.sent()) {
+                            writer.close();
+                            writer.send(500, "internal server error\n");
+                        }
+                    }
+                    stream.ingore(parser.consumed());
+                    parser.reset();
+                    if (!writer.keepAlive()) {
+                        stream.flush();
+                        break;
+                    }
+                    continue;
+                }
+
+                if (status == ParseStatus::Error) {
+                    writer.reset(false);
+                    writer.send(parser.errorStatus(), reasonPhrase(parser.errorStatus()));
+                    stream.flush();
+                    break;
+                }
+
+                // every buffered request is answered, the batch goes out in one write before waiting for more
+                stream.flush();
+                stream.fillmore();
+            }
+        } catch (Stream::EOFException&) {
+            // the peer closed the connection
+        } catch (std::system_error& ex) {
+            spdlog::debug("http: {}", ex.what());
+        }
+    }
+
+    void serve(SocketAddress const& addr, Handler handler, ServerOptions const& options) {
+        socket_listen_sharded(
+            addr, [handler = std::move(handler), options](SocketHandle sock) {
+                serve_connection(std::move(sock), handler, options);
+            },
+            options.listen);
+    }
+
+} // namespace sylar::http
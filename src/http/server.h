@@ -0,0 +1,28 @@
+#pragma once
+
+#include "file/socket.h"
+#include "request.h"
+#include "response.h"
+
+#include <functional>
+
+namespace sylar::http {
+    // the request is valid until the handler returns, the handler must send exactly one response
+    using Handler = std::function<void(Request const&, ResponseWriter&)>;
+
+    struct ServerOptions {
+        std::size_t max_head_size = 8192;
+        std::size_t max_body_size = 1024 * 1024;
+        // a connection without a complete request within the timeout is closed
+        UringOp::timeout_type idle_timeout = std::nullopt;
+        ShardedListenOptions listen;
+    };
+
+    // Serve the HTTP/1.1 connections of sock until it's closed, pipelined requests are parsed in place from the read
+    // buffer and their responses go out with a single flush once no complete request is left.
+    void serve_connection(SocketHandle sock, Handler const& handler, ServerOptions const& options = {});
+
+    // one listener and accept loop per processor, see socket_listen_sharded
+    void serve(SocketAddress const& addr, Handler handler, ServerOptions const& options = {});
+
+} // namespace sylar::http
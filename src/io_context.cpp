@@ -1,47 +1,235 @@
 #include "io_context.h"
 
-#include <cstdlib>
 #include <latch>
 #include <liburing.h>
+#include <map>
 #include <spdlog/spdlog.h>
 
 namespace sylar {
-    namespace {
-        size_t randamN(size_t N) { return static_cast<size_t>(rand()) % N; }
-    } // namespace
+    void IOContext::initTopology() {
+        auto nr_processors = options_.thread_count;
+        topology_ = Topology::discover();
+        if (options_.pin_threads) {
+            placement_ = topology_.place(nr_processors);
+        }
+
+        std::map<int, std::size_t> node_queue;
+        for (auto const& cpu : placement_) {
+            node_queue.emplace(cpu.node, node_queue.size());
+        }
+        rqs_.resize(std::max<std::size_t>(node_queue.size(), 1));
+        for (auto& rq : rqs_) {
+            rq = std::make_unique<GlobalRunQueue>();
+        }
+        queue_of_.assign(nr_processors, 0);
+        victims_.resize(nr_processors);
+        for (std::size_t i = 0; i < nr_processors; i++) {
+            if (!placement_.empty()) {
+                queue_of_[i] = node_queue[placement_[i].node];
+            }
+            for (std::size_t j = 0; j < nr_processors; j++) {
+                if (i == j) {
+                    continue;
+                }
+                // without pinning the processors may be anywhere, they are all at the same distance
+                auto distance = placement_.empty() ? 2 : cpuDistance(placement_[i], placement_[j]);
+                victims_[i][static_cast<std::size_t>(distance)].push_back(j);
+            }
+        }
+        if (!placement_.empty()) {
+            spdlog::info("IOContext: {} processors pinned over {} NUMA nodes", nr_processors, rqs_.size());
+        }
+    }
 
     size_t IOContext::stealTasks(uint64_t id, RunQueue& rq) {
-        // get tasks from global queue
-        auto size = this->rq_.steal(rq, true);
+        // get tasks from the global queue of our node
+        auto size = globalQueue(id).steal(rq);
         if (size > 0) {
             return size;
         }
-        // steal tasks from other processors
-        uint64_t start = randamN(processors_.size());
-        for (size_t i = 0; i < processors_.size(); i++) {
-            auto pid = (start + i) % processors_.size();
-            if (pid == id) {
+        // steal tasks from other processors, the nearest first, in random order at the same distance
+        for (std::size_t distance = 0; distance <= Topology::MAX_DISTANCE; distance++) {
+            if (distance == Topology::MAX_DISTANCE) {
+                // the global queues of the other nodes before their processors
+                for (auto const& other : rqs_) {
+                    if (other.get() != &globalQueue(id) && (size = other->steal(rq)) > 0) {
+                        return size;
+                    }
+                }
+            }
+            auto const& victims = victims_[id][distance];
+            if (victims.empty()) {
                 continue;
             }
-            auto size = processors_[pid]->stealTasks(rq);
-            if (size > 0) {
-                return size;
+            auto start = fastRandom() % victims.size();
+            for (std::size_t i = 0; i < victims.size(); i++) {
+                auto pid = victims[(start + i) % victims.size()];
+                size = processors_[pid]->stealTasks(rq);
+                if (size > 0) {
+                    trace(TraceEvent::FiberSteal, pid, static_cast<int64_t>(size));
+                    if (distance == Topology::MAX_DISTANCE) {
+                        processors_[id]->metrics_.tasks_stolen_remote.add(size);
+                    }
+                    return size;
+                }
             }
         }
         return 0;
     }
 
+    void IOContext::wakeProcessor() {
+        // a spinning processor will find the task
+        if (nr_idle_.load() == 0 || nr_spinning_.load() != 0) {
+            return;
+        }
+        size_t expected = 0;
+        if (!nr_spinning_.compare_exchange_strong(expected, 1)) {
+            return;
+        }
+
+        Processor* processor = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            if (!idle_.empty()) {
+                processor = idle_.back();
+                idle_.pop_back();
+                --nr_idle_;
+                processor->idle_ = false;
+                // the woken processor starts spinning, it has been counted above
+                processor->spinning_ = true;
+            }
+        }
+        if (processor == nullptr) {
+            --nr_spinning_;
+            return;
+        }
+        processor->wakeup();
+    }
+
+    bool IOContext::startSpinning() {
+        // limit the number of spinning processors to half of the busy ones
+        auto busy = processors_.size() - nr_idle_.load();
+        if (2 * nr_spinning_.load() >= busy) {
+            return false;
+        }
+        ++nr_spinning_;
+        return true;
+    }
+
+    bool IOContext::parkProcessor(Processor& processor) {
+        bool spinning = std::exchange(processor.spinning_, false);
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            idle_.push_back(&processor);
+            processor.idle_ = true;
+            ++nr_idle_;
+        }
+        if (spinning) {
+            --nr_spinning_;
+        }
+
+        // a spawner may have skipped the wakeup since we were spinning, check again after we are visible as idle
+        if (!hasTasks() && !stop_.load()) {
+            return true;
+        }
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        if (processor.idle_) {
+            std::erase(idle_, &processor);
+            processor.idle_ = false;
+            --nr_idle_;
+            processor.spinning_ = true;
+            ++nr_spinning_;
+        }
+        return false;
+    }
+
+    void IOContext::unparkProcessor(Processor& processor) {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        if (processor.idle_) {
+            std::erase(idle_, &processor);
+            processor.idle_ = false;
+            --nr_idle_;
+        }
+    }
+
+    bool IOContext::hasTasks() const {
+        for (auto const& rq : rqs_) {
+            if (rq->size() != 0) {
+                return true;
+            }
+        }
+        for (auto* processor : processors_) {
+            if (processor && processor->rq_.size() > 1) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    MetricsSnapshot IOContext::getMetrics() const {
+        MetricsSnapshot snapshot;
+        for (auto* processor : processors_) {
+            snapshot.processors.push_back(processor ? processor->getMetrics() : ProcessorSnapshot{});
+        }
+        for (auto const& rq : rqs_) {
+            snapshot.global_queue_depth += rq->size();
+        }
+        return snapshot;
+    }
+
+    SubmitStats IOContext::getSubmitStats() const {
+        SubmitStats stats;
+        for (auto* processor : processors_) {
+            if (processor) {
+                stats += processor->getSubmitStats();
+            }
+        }
+        return stats;
+    }
+
+    std::vector<SpinStats> IOContext::getSpinStats() const {
+        std::vector<SpinStats> stats;
+        for (auto* processor : processors_) {
+            stats.push_back(processor ? processor->getSpinStats() : SpinStats{});
+        }
+        return stats;
+    }
+
+    void IOContext::stop() {
+        stop_ = true;
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        for (auto* processor : idle_) {
+            processor->wakeup();
+        }
+    }
+
     void IOContext::execute() {
         // make sure all processor is initialized
         std::latch init_finish(static_cast<std::ptrdiff_t>(threads_.size()) + 1);
+        // with SQPOLL the rings of the other processors attach to the SQ thread of processor 0
+        bool share_sq = options_.ring_mode == RingMode::SqPoll;
+        std::latch first_ring(1);
 
         for (size_t i = 0; i < threads_.size(); ++i) {
-            threads_[i] = std::thread([&, i]() {
-                Processor processor(i, hook_);
+            threads_[i] = std::thread([&, i, share_sq]() {
+                // before the ring and the stacks are allocated, their memory comes from the node of the CPU
+                if (!placement_.empty()) {
+                    schedSetThreadAffinity(static_cast<std::size_t>(placement_[i].cpu));
+                }
+                int attach_fd = -1;
+                if (share_sq && i != 0) {
+                    first_ring.wait();
+                    attach_fd = processors_[0]->uring_.ring_fd;
+                }
+                Processor processor(i, options_, attach_fd);
                 processors_[i] = &processor;
+                if (i == 0) {
+                    first_ring.count_down();
+                }
 
                 init_finish.arrive_and_wait();
                 processor.execute();
+                exited_.arrive_and_wait();
             });
         }
         init_finish.arrive_and_wait();
@@ -1,10 +1,20 @@
 #pragma once
 
 #include "detail/fiber.h"
+#include "detail/topology.h"
+#include "options.h"
 #include "processor.h"
 #include "runqueue.h"
+#include "task.h"
+#include "tracer.h"
 #include "util.h"
 
+#include <array>
+#include <atomic>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <spdlog/spdlog.h>
 
 namespace sylar {
@@ -12,12 +22,19 @@ namespace sylar {
     public:
         using Func = std::function<void()>;
         using Task = Fiber*;
+        using Options = IOContextOptions;
 
-        explicit IOContext(size_t thread_count = std::thread::hardware_concurrency(), bool hook = false) : hook_(hook) {
+        explicit IOContext(size_t thread_count = std::thread::hardware_concurrency(), bool hook = false)
+            : IOContext(Options{.thread_count = thread_count, .hook = hook}) {}
+        explicit IOContext(Options const& options) : options_(options) {
             assertThat(instance == nullptr);
             instance = this;
-            threads_.resize(thread_count);
-            processors_.resize(thread_count);
+            threads_.resize(options_.thread_count);
+            processors_.resize(options_.thread_count);
+            if (options_.trace_events != 0) {
+                Tracer::enable(options_.trace_events);
+            }
+            initTopology();
         }
         ~IOContext() {
             for (auto& thread : threads_) {
@@ -31,18 +48,26 @@ namespace sylar {
         }
 
         void execute();
+        // ask all processors to exit their loop, the destructor joins them
+        void stop();
+        bool isStopped() const { return stop_.load(std::memory_order_relaxed); }
 
         // spawn a task, like keyword go in golang
         // by default push task into processor's local task queue, if it's full, push the task into gloabl queue
         static void spawn(Func const& func) {
             assertThat(instance);
+            spawn(func, instance->options_.stack_size);
+        }
+        static void spawn(Func const& func, uint32_t stack_size) {
+            assertThat(instance);
 
             auto* processor = Processor::getProcessor();
             if (processor == nullptr || processor->isFull()) {
-                instance->emplaceTask(func);
+                instance->emplaceTask(func, stack_size);
             } else {
-                processor->emplaceTask(func);
+                processor->emplaceTask(func, stack_size);
             }
+            instance->wakeProcessor();
         }
         static void spawn(Task task) {
             assertThat(instance);
@@ -53,21 +78,112 @@ namespace sylar {
             } else {
                 processor->emplaceTask(task);
             }
+            instance->wakeProcessor();
+        }
+
+        // spawn a fiber with an affinity to a processor and its own stack size
+        static void spawn(Func const& func, SpawnOptions const& options) {
+            assertThat(instance);
+
+            auto* processor = Processor::getProcessor();
+            if (processor == nullptr) {
+                // only a processor can build the fiber
+                spawn([func, options]() { spawn(func, options); });
+                return;
+            }
+            Processor::ready(processor->buildTask(func, options));
+            instance->wakeProcessor();
+        }
+
+        // spawn a fiber pinned to the processor processor_id, it is never stolen by other processors
+        static void spawnOn(uint64_t processor_id, Func const& func) {
+            assertThat(instance && processor_id < instance->options_.thread_count);
+
+            auto* processor = Processor::getProcessor();
+            if (processor == nullptr) {
+                // only a processor can send the fiber over
+                spawn([processor_id, func]() { spawnOn(processor_id, func); });
+                return;
+            }
+            processor->emplaceTask(processor->buildPinnedTask(func, processor_id));
+        }
+
+        std::size_t getProcessorCount() const { return options_.thread_count; }
+        Topology const& getTopology() const { return topology_; }
+        // the CPU of each processor, empty unless pin_threads
+        std::vector<CpuInfo> const& getPlacement() const { return placement_; }
+        Options const& getOptions() const { return options_; }
+        // read the metrics of the processors without stopping them, while they are running
+        MetricsSnapshot getMetrics() const;
+        // submission counters summed over the processors, while they are running
+        SubmitStats getSubmitStats() const;
+        // busy polling counters of each processor, while they are running
+        std::vector<SpinStats> getSpinStats() const;
+
+        // spawn a stackless task, it runs on the current processor, or on the processor picking it up from the global
+        // queue when spawned outside of the runtime
+        static void spawn(sylar::Task<void> task) {
+            auto coroutine = detail::detach(std::move(task)).handle_;
+            auto* processor = Processor::getProcessor();
+            if (processor != nullptr) {
+                processor->emplaceCoroutine(coroutine);
+            } else {
+                spawn([coroutine]() { Processor::getProcessor()->emplaceCoroutine(coroutine); });
+            }
         }
 
     private:
         friend class Processor;
+        // placement of the processors, their global queues and the order they steal in
+        void initTopology();
         size_t stealTasks(uint64_t id, RunQueue& rq);
 
-        void emplaceTask(Func const& func) { rq_.emplace(func); }
-        void emplaceTask(Task task) { rq_.emplace(task); }
-
-        bool hook_;
-
-        RunQueue rq_;
+        GlobalRunQueue& globalQueue(uint64_t processor_id) { return *rqs_[queue_of_[processor_id]]; }
+        // the queue of the current processor, outside of the processors the queues take turns
+        GlobalRunQueue& globalQueue() {
+            auto* processor = Processor::getProcessor();
+            if (processor != nullptr) {
+                return globalQueue(processor->id_);
+            }
+            return *rqs_[next_queue_.fetch_add(1, std::memory_order_relaxed) % rqs_.size()];
+        }
+        void emplaceTask(Func const& func, uint32_t stack_size) { globalQueue().emplace(func, stack_size); }
+        void emplaceTask(Task task) { globalQueue().emplace(task); }
+
+        // Idle processors park in io_uring, the accounting of spinning processors (looking for tasks to steal) is
+        // modeled on the Go scheduler: a spawner only wakes a parked processor if no one is spinning, and the last
+        // spinning processor which finds tasks wakes up another one, so we never wake more processors than there
+        // are runnable tasks.
+        void wakeProcessor();
+        bool startSpinning();
+        // return false if tasks showed up while parking, the processor should keep running
+        bool parkProcessor(Processor& processor);
+        void unparkProcessor(Processor& processor);
+        bool hasTasks() const;
+
+        Options options_;
+        std::atomic<bool> stop_{false};
+
+        Topology topology_;
+        // the CPU of each processor, empty unless pin_threads
+        std::vector<CpuInfo> placement_;
+        // one global queue per NUMA node of the placement, or a single one
+        std::vector<std::unique_ptr<GlobalRunQueue>> rqs_;
+        std::vector<std::size_t> queue_of_;
+        std::atomic<std::size_t> next_queue_{0};
+        // the other processors by distance from each processor, see cpuDistance
+        std::vector<std::array<std::vector<uint64_t>, Topology::MAX_DISTANCE + 1>> victims_;
 
         std::vector<std::thread> threads_;
         std::vector<Processor*> processors_;
+        // a processor lives on the stack of its thread, the others steal from it and post to its ring until they are
+        // all out of their loop
+        std::latch exited_{static_cast<std::ptrdiff_t>(options_.thread_count)};
+
+        std::mutex idle_mutex_;
+        std::vector<Processor*> idle_;
+        std::atomic<size_t> nr_idle_{0};
+        std::atomic<size_t> nr_spinning_{0};
 
         static inline IOContext* instance;
     };
@@ -0,0 +1,125 @@
+#include "metrics.h"
+#include "file/socket.h"
+#include "io_context.h"
+#include "tracer.h"
+
+#include <memory>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+namespace sylar {
+    ProcessorSnapshot& ProcessorSnapshot::operator+=(ProcessorSnapshot const& that) {
+#define SYLAR_METRIC_ADD(member, name, help, divisor) member += that.member;
+        SYLAR_PROCESSOR_COUNTERS(SYLAR_METRIC_ADD)
+        SYLAR_PROCESSOR_GAUGES(SYLAR_METRIC_ADD)
+#undef SYLAR_METRIC_ADD
+        return *this;
+    }
+
+    ProcessorSnapshot MetricsSnapshot::total() const {
+        ProcessorSnapshot total;
+        for (auto const& processor : processors) {
+            total += processor;
+        }
+        return total;
+    }
+
+    namespace {
+        void appendSeries(std::string& out, std::string_view name, std::string_view help, std::string_view type,
+                          std::vector<ProcessorSnapshot> const& processors, uint64_t ProcessorSnapshot::*member,
+                          double divisor) {
+            fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+            for (std::size_t i = 0; i < processors.size(); i++) {
+                auto value = processors[i].*member;
+                if (divisor == 1) {
+                    fmt::format_to(std::back_inserter(out), "{}{{processor=\"{}\"}} {}\n", name, i, value);
+                } else {
+                    fmt::format_to(std::back_inserter(out), "{}{{processor=\"{}\"}} {}\n", name, i,
+                                   static_cast<double>(value) / divisor);
+                }
+            }
+        }
+    } // namespace
+
+    std::string MetricsSnapshot::toPrometheus() const {
+        std::string out;
+#define SYLAR_METRIC_COUNTER(member, name, help, divisor)                                                              \
+    appendSeries(out, name, help, "counter", processors, &ProcessorSnapshot::member, divisor);
+#define SYLAR_METRIC_GAUGE(member, name, help, divisor)                                                                \
+    appendSeries(out, name, help, "gauge", processors, &ProcessorSnapshot::member, divisor);
+        SYLAR_PROCESSOR_COUNTERS(SYLAR_METRIC_COUNTER)
+        SYLAR_PROCESSOR_GAUGES(SYLAR_METRIC_GAUGE)
+#undef SYLAR_METRIC_COUNTER
+#undef SYLAR_METRIC_GAUGE
+        fmt::format_to(std::back_inserter(out),
+                       "# HELP sylar_global_queue_depth Fibers in the global run queue\n"
+                       "# TYPE sylar_global_queue_depth gauge\n"
+                       "sylar_global_queue_depth {}\n",
+                       global_queue_depth);
+        return out;
+    }
+
+    namespace {
+        constexpr std::size_t MAX_REQUEST_SIZE = 8192;
+
+        void serveScrape(SocketHandle sock) {
+            std::string request;
+            char buf[1024];
+            while (request.find("\r\n\r\n") == std::string::npos) {
+                auto ret = socket_read(sock, buf);
+                if (ret <= 0 || request.size() > MAX_REQUEST_SIZE) {
+                    file_close(std::move(sock));
+                    return;
+                }
+                request.append(buf, static_cast<std::size_t>(ret));
+            }
+
+            std::string body;
+            std::string_view status = "200 OK";
+            std::string_view type = "text/plain; version=0.0.4";
+            if (request.starts_with("GET /metrics ") || request.starts_with("GET / ")) {
+                body = IOContext::getInstance()->getMetrics().toPrometheus();
+            } else if (request.starts_with("GET /trace ")) {
+                body = Tracer::dumpChromeTrace();
+                type = "application/json";
+            } else {
+                status = "404 Not Found";
+            }
+            auto response = fmt::format("HTTP/1.1 {}\r\n"
+                                        "Content-Type: {}\r\n"
+                                        "Content-Length: {}\r\n"
+                                        "Connection: close\r\n"
+                                        "\r\n"
+                                        "{}",
+                                        status, type, body.size(), body);
+            std::span<char const> out(response);
+            while (!out.empty()) {
+                out = out.subspan(static_cast<std::size_t>(socket_write(sock, out)));
+            }
+            file_close(std::move(sock));
+        }
+    } // namespace
+
+    void metrics_serve(SocketAddress const& addr) {
+        auto listener = std::make_shared<SocketListener>(socket_listen(addr, SOMAXCONN));
+        IOContext::spawn([listener]() {
+            while (true) {
+                try {
+                    // std::function needs a copyable callable
+                    auto sock = std::make_shared<SocketHandle>(socket_accept(*listener));
+                    IOContext::spawn([sock]() {
+                        try {
+                            serveScrape(std::move(*sock));
+                        } catch (std::system_error& ex) {
+                            spdlog::warn("metrics: {}", ex.what());
+                        }
+                    });
+                } catch (std::system_error& ex) {
+                    spdlog::error("metrics: accept: {}", ex.what());
+                }
+            }
+        });
+    }
+
+} // namespace sylar
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// counters of a processor: member, Prometheus name, help, unit divisor of the exported value
+#define SYLAR_PROCESSOR_COUNTERS(X)                                                                                    \
+    X(context_switches, "sylar_context_switches_total", "Fibers and coroutines resumed", 1)                            \
+    X(steal_attempts, "sylar_steal_attempts_total", "Attempts to steal from other processors", 1)                      \
+    X(steal_successes, "sylar_steal_successes_total", "Attempts which stole tasks", 1)                                 \
+    X(tasks_stolen, "sylar_tasks_stolen_total", "Tasks stolen from other processors", 1)                               \
+    X(tasks_stolen_remote, "sylar_tasks_stolen_remote_total", "Tasks stolen from processors of other NUMA nodes", 1)   \
+    X(fibers_created, "sylar_fibers_created_total", "Fibers allocated with a new stack", 1)                            \
+    X(fibers_reused, "sylar_fibers_reused_total", "Fibers taken from the free list", 1)                                \
+    X(timers_fired, "sylar_timers_fired_total", "Expired timers", 1)                                                   \
+    X(submits, "sylar_submits_total", "Submissions of SQEs to the kernel", 1)                                          \
+    X(sqes_submitted, "sylar_sqes_submitted_total", "SQEs submitted", 1)                                               \
+    X(cqes_reaped, "sylar_cqes_reaped_total", "CQEs reaped", 1)                                                        \
+    X(cq_overflows, "sylar_cq_overflows_total", "Rounds in which the CQ ring overflowed", 1)                           \
+    X(dropped_cqes, "sylar_dropped_cqes_total", "CQEs dropped by the kernel on overflow", 1)                           \
+    X(spin_hits, "sylar_spin_hits_total", "Busy polls which found work", 1)                                            \
+    X(spin_misses, "sylar_spin_misses_total", "Busy polls which ran out of budget", 1)                                 \
+    X(busy_ns, "sylar_busy_seconds_total", "Time spent running tasks, stealing and polling", 1e9)                      \
+    X(idle_ns, "sylar_idle_seconds_total", "Time spent parked in the kernel", 1e9)
+
+// gauges of a processor, sampled when the snapshot is taken
+#define SYLAR_PROCESSOR_GAUGES(X)                                                                                      \
+    X(run_queue_depth, "sylar_run_queue_depth", "Fibers in the local run queue", 1)                                    \
+    X(pending_ops, "sylar_pending_ops", "Ops submitted and not completed yet", 1)                                      \
+    X(timers, "sylar_timers", "Timers armed", 1)                                                                       \
+    X(spin_budget_ns, "sylar_spin_budget_seconds", "Current busy poll budget", 1e9)
+
+namespace sylar {
+    // Counter with a single writer: the owner adds with a relaxed load and store instead of a locked
+    // read-modify-write, any thread may read it
+    class Counter {
+    public:
+        void add(uint64_t n = 1) noexcept {
+            value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+        void set(uint64_t value) noexcept { value_.store(value, std::memory_order_relaxed); }
+        uint64_t get() const noexcept { return value_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> value_{};
+    };
+
+    // counters of a processor, written by its thread only, on cache lines of their own so that updating them never
+    // bounces a line another processor writes
+    struct alignas(64) ProcessorMetrics {
+#define SYLAR_METRIC_MEMBER(member, name, help, divisor) Counter member;
+        SYLAR_PROCESSOR_COUNTERS(SYLAR_METRIC_MEMBER)
+        // the gauges which are not sampled from elsewhere
+        Counter timers;
+        Counter spin_budget_ns;
+#undef SYLAR_METRIC_MEMBER
+    };
+
+    struct ProcessorSnapshot {
+#define SYLAR_METRIC_MEMBER(member, name, help, divisor) uint64_t member = 0;
+        SYLAR_PROCESSOR_COUNTERS(SYLAR_METRIC_MEMBER)
+        SYLAR_PROCESSOR_GAUGES(SYLAR_METRIC_MEMBER)
+#undef SYLAR_METRIC_MEMBER
+
+        ProcessorSnapshot& operator+=(ProcessorSnapshot const& that);
+    };
+
+    // the metrics of all processors, read without stopping them, so counters of different processors are not
+    // taken at the same instant
+    struct MetricsSnapshot {
+        std::vector<ProcessorSnapshot> processors;
+        uint64_t global_queue_depth = 0;
+
+        // sum over the processors
+        ProcessorSnapshot total() const;
+        // Prometheus text exposition format, one series per processor
+        std::string toPrometheus() const;
+    };
+
+    // counters of the submissions of a processor, rates are taken from two snapshots
+    struct SubmitStats {
+        // io_uring_enter calls which submitted SQEs
+        uint64_t submits = 0;
+        uint64_t sqes = 0;
+        // rounds in which the CQ ring overflowed into the kernel backlog
+        uint64_t cq_overflows = 0;
+        // completions the kernel failed to keep on overflow, their ops never complete
+        uint64_t dropped_cqes = 0;
+
+        double sqesPerSubmit() const {
+            return submits == 0 ? 0 : static_cast<double>(sqes) / static_cast<double>(submits);
+        }
+
+        SubmitStats& operator+=(SubmitStats const& that) {
+            submits += that.submits;
+            sqes += that.sqes;
+            cq_overflows += that.cq_overflows;
+            dropped_cqes += that.dropped_cqes;
+            return *this;
+        }
+    };
+
+    // counters of the CQ polling before parking, see IOContextOptions::busy_poll_us
+    struct SpinStats {
+        // completions or tasks showed up while polling
+        uint64_t hits = 0;
+        // the budget ran out, the processor parked
+        uint64_t misses = 0;
+        // current budget
+        std::chrono::nanoseconds budget{};
+    };
+
+    struct SocketAddress;
+
+    // Serve GET /metrics in Prometheus text format, and GET /trace with the Chrome trace of the Tracer, on addr from
+    // fibers of the runtime, returns once listening.
+    // Must be called in a fiber. Nothing is paid between two scrapes besides the counting.
+    void metrics_serve(SocketAddress const& addr);
+
+} // namespace sylar
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "detail/fiber.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <thread>
+
+namespace sylar {
+    // setup of the ring of each processor, a mode the kernel refuses falls back to Default with a warning
+    enum class RingMode {
+        // completions are posted from interrupts and task work as they come
+        Default,
+        // IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_COOP_TASKRUN: completions are only
+        // processed when the processor enters the ring, no task work interrupts the running fiber
+        DeferTaskrun,
+        // IORING_SETUP_SQPOLL: a kernel thread polls the submission queues, shared by the rings of all processors
+        // (IORING_SETUP_ATTACH_WQ), submitting needs no syscall while the thread is awake
+        SqPoll,
+    };
+
+    // where a spawned fiber runs
+    enum class Affinity {
+        // anywhere, the fiber runs where it is woken up or stolen
+        None,
+        // a home processor: wakeups send the fiber back there, e.g. where the state of its connection is cache-hot,
+        // but idle processors may still steal it
+        Soft,
+        // only on its processor, it is never stolen, see Processor::pin
+        Pinned,
+    };
+
+    struct SpawnOptions {
+        Affinity affinity = Affinity::None;
+        // the processor of a Soft or Pinned fiber, the spawning one by default
+        std::optional<uint64_t> processor;
+        // 0 for IOContextOptions::stack_size
+        uint32_t stack_size = 0;
+    };
+
+    struct IOContextOptions {
+        std::size_t thread_count = std::thread::hardware_concurrency();
+        // hook blocking syscalls in processor threads
+        bool hook = false;
+        // stack size of spawned fibers unless given at spawn
+        uint32_t stack_size = Fiber::DEFAULT_STACK_SIZE;
+        // entries of the submission queue of each processor's ring
+        unsigned ring_entries = 256;
+        // entries of the completion queue (IORING_SETUP_CQSIZE), 0 keeps the kernel default of 2 * ring_entries.
+        // Completions which don't fit wait in a kernel backlog until the processor reaps the ring.
+        unsigned cq_entries = 0;
+        // submit as soon as submit_batch SQEs are queued, 0 submits once per scheduling round or when the submission
+        // queue is full
+        unsigned submit_batch = 0;
+        RingMode ring_mode = RingMode::Default;
+        // Pin each processor thread to a CPU, the first threads of the cores of a NUMA node first, then their SMT
+        // siblings, then the next node. Pinned processors steal from the nearest ones first and share a global queue
+        // per NUMA node, unpinned ones steal in random order and share one global queue.
+        bool pin_threads = false;
+        // Before parking with ops in flight, poll the CQ ring for up to busy_poll_us microseconds. The budget adapts
+        // to the recent hit rate, between busy_poll_us / 64 and busy_poll_us. 0 disables it, so does DeferTaskrun
+        // whose completions only show up when entering the ring.
+        uint32_t busy_poll_us = 0;
+        // enable the Tracer from the start with buffers of trace_events events per processor, 0 leaves it off
+        std::size_t trace_events = 0;
+        // SqPoll: idle time in milliseconds before the SQ thread sleeps, and the CPU it is bound to (-1 for none)
+        unsigned sq_thread_idle = 1000;
+        int sq_thread_cpu = -1;
+        // slots of the registered file table of each processor, accepted sockets and opened files go straight into
+        // it, 0 disables fixed files
+        unsigned fixed_files = 0;
+        // provided buffers of each processor (a power of 2) for the multishot recv of SocketStream, memory for
+        // received data then scales with the data in flight instead of the number of streams, 0 disables them
+        unsigned recv_buffers = 0;
+        uint32_t recv_buffer_size = 8192;
+        // socket_send_zc copies smaller buffers, pinning the pages and the extra notification cost more than a copy
+        std::size_t send_zc_threshold = 64 * 1024;
+    };
+
+} // namespace sylar
@@ -5,120 +5,651 @@
 #include "util.h"
 
 #include <chrono>
+#include <cstring>
 #include <liburing.h>
 #include <spdlog/spdlog.h>
-#include <thread>
-
-constexpr std::chrono::system_clock::duration MAX_EVENT_WAIT = std::chrono::milliseconds(10);
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
 
 namespace sylar {
-    Processor::Processor(uint64_t id, bool hook, unsigned int entries) : id_(id) {
+    namespace {
+        // tags in the low bits of CQE user data, UringData and Fiber are at least 8-byte aligned
+        enum CqeTag : uint64_t {
+            OP_TAG = 0,     // UringData of an UringOp
+            WAKEUP_TAG = 1, // the wakeup eventfd read
+            POST_TAG = 2,   // a fiber sent to another processor, the completion on the sender's ring
+            POSTED_TAG = 3, // a fiber received from another processor
+            HANDLER_TAG = 4, // an UringHandler of a multishot op
+        };
+        constexpr uint64_t TAG_MASK = 0b111;
+
+        template <class T>
+        uint64_t tagged(T* ptr, CqeTag tag) {
+            return reinterpret_cast<uint64_t>(ptr) | tag;
+        }
+        template <class T = Fiber>
+        T* untagged(uint64_t data) {
+            return reinterpret_cast<T*>(data & ~TAG_MASK);
+        }
+    } // namespace
+
+    Processor::Processor(uint64_t id, IOContextOptions const& options, int attach_fd)
+        : id_(id), stack_size_(options.stack_size), submit_batch_(options.submit_batch) {
         assertThat(t_processor == nullptr);
         t_processor = this;
-        checkRetUring(io_uring_queue_init(entries, &uring_, 0));
+        initRing(options, attach_fd);
+        if (options.busy_poll_us != 0 && !isSingleIssuer()) {
+            spin_max_ = std::chrono::microseconds(options.busy_poll_us);
+            metrics_.spin_budget_ns.set(static_cast<uint64_t>(spin_max_.count()));
+        }
+        wakeup_fd_ = checkRet(eventfd(0, EFD_CLOEXEC));
+        if (options.fixed_files != 0) {
+            int ret = io_uring_register_files_sparse(&uring_, options.fixed_files);
+            if (ret < 0) {
+                spdlog::warn("Processor {}: registered files disabled: {}", id_, strerror(-ret));
+            } else {
+                fixed_files_ = options.fixed_files;
+            }
+        }
+        if (options.recv_buffers != 0) {
+            buffer_ring_ = std::make_unique<BufferRing>(&uring_, 0, options.recv_buffers, options.recv_buffer_size);
+        }
         Fiber::t_current_fiber = &t_processor_fiber;
 
-        if (hook) {
+        if (options.hook) {
             setHookEnable(true);
         }
     }
 
-    Processor::~Processor() { io_uring_queue_exit(&uring_); }
+    void Processor::initRing(IOContextOptions const& options, int attach_fd) {
+        struct io_uring_params params{};
+        if (options.cq_entries != 0) {
+            params.flags |= IORING_SETUP_CQSIZE;
+            params.cq_entries = options.cq_entries;
+        }
+        auto base_flags = params.flags;
+        switch (options.ring_mode) {
+        case RingMode::Default:
+            break;
+        case RingMode::DeferTaskrun:
+            // the ring is created by the processor thread, it is the only one to submit
+            params.flags |= IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_COOP_TASKRUN;
+            break;
+        case RingMode::SqPoll:
+            params.flags |= IORING_SETUP_SQPOLL;
+            params.sq_thread_idle = options.sq_thread_idle;
+            if (options.sq_thread_cpu >= 0) {
+                params.flags |= IORING_SETUP_SQ_AFF;
+                params.sq_thread_cpu = static_cast<uint32_t>(options.sq_thread_cpu);
+            }
+            if (attach_fd >= 0) {
+                params.flags |= IORING_SETUP_ATTACH_WQ;
+                params.wq_fd = static_cast<uint32_t>(attach_fd);
+            }
+            break;
+        }
+
+        int ret = io_uring_queue_init_params(options.ring_entries, &uring_, &params);
+        if (ret < 0 && (params.flags & IORING_SETUP_ATTACH_WQ)) {
+            // e.g. the ring to attach to has no SQ thread, poll with our own
+            params.flags &= ~IORING_SETUP_ATTACH_WQ;
+            ret = io_uring_queue_init_params(options.ring_entries, &uring_, &params);
+        }
+        if (ret < 0 && params.flags != base_flags) {
+            spdlog::warn("Processor {}: ring setup flags {:#x} refused: {}, falling back to the default mode", id_,
+                         params.flags, strerror(-ret));
+            params = {};
+            params.flags = base_flags;
+            params.cq_entries = options.cq_entries;
+            ret = io_uring_queue_init_params(options.ring_entries, &uring_, &params);
+        }
+        checkRetUring(ret);
+        if (!(params.features & IORING_FEAT_NODROP)) {
+            spdlog::warn("Processor {}: completions are dropped when the CQ ring overflows", id_);
+        }
+    }
+
+    Processor::~Processor() {
+        buffer_ring_.reset();
+        io_uring_queue_exit(&uring_);
+        close_f(wakeup_fd_);
+    }
 
     struct io_uring_sqe* Processor::getSqe() {
+        struct io_uring_sqe* sqe = allocSqe();
+        ++pending_ops_;
+        return sqe;
+    }
+
+    struct io_uring_sqe* Processor::allocSqe() {
+        if (submit_batch_ != 0 && io_uring_sq_ready(&uring_) >= submit_batch_ &&
+            !(last_sqe_ != nullptr && (last_sqe_->flags & IOSQE_IO_LINK))) {
+            submit();
+        }
         struct io_uring_sqe* sqe = io_uring_get_sqe(&uring_);
         while (!sqe) {
-            int res = io_uring_submit(&uring_);
-            if (res < 0) [[unlikely]] {
-                if (res == -EINTR) {
-                    continue;
-                }
-                throw std::system_error(-res, std::system_category());
+            submit();
+            if (isSqPoll()) {
+                // the SQ thread has not consumed the queue yet
+                io_uring_sqring_wait(&uring_);
             }
             sqe = io_uring_get_sqe(&uring_);
         }
-        ++pending_ops_;
+        last_sqe_ = sqe;
         return sqe;
     }
 
+    void Processor::submit() {
+        auto ready = io_uring_sq_ready(&uring_);
+        int res = io_uring_submit(&uring_);
+        if (res == -EBUSY || res == -EAGAIN) {
+            // the CQ ring overflowed, the kernel takes no more SQEs until we make room, unless a handler run by
+            // reapCompletions submits, then the reaping in progress makes room
+            if (!reaping_) {
+                reapCompletions();
+            }
+            return;
+        }
+        if (res < 0 && res != -EINTR) [[unlikely]] {
+            throw std::system_error(-res, std::system_category());
+        }
+        if (res >= 0) {
+            countSubmit(ready);
+        }
+    }
+
+    void Processor::countSubmit(unsigned sqes) {
+        if (sqes == 0) {
+            return;
+        }
+        metrics_.submits.add();
+        metrics_.sqes_submitted.add(sqes);
+        trace(TraceEvent::Submit, 0, sqes);
+    }
+
+    ProcessorSnapshot Processor::getMetrics() const {
+        ProcessorSnapshot snapshot;
+#define SYLAR_METRIC_READ(member, name, help, divisor) snapshot.member = metrics_.member.get();
+        SYLAR_PROCESSOR_COUNTERS(SYLAR_METRIC_READ)
+#undef SYLAR_METRIC_READ
+        snapshot.run_queue_depth = rq_.size();
+        snapshot.pending_ops = pending_ops_.load(std::memory_order_relaxed);
+        snapshot.timers = metrics_.timers.get();
+        snapshot.spin_budget_ns = metrics_.spin_budget_ns.get();
+        return snapshot;
+    }
+
+    SpinStats Processor::getSpinStats() const {
+        return {
+            .hits = metrics_.spin_hits.get(),
+            .misses = metrics_.spin_misses.get(),
+            .budget = std::chrono::nanoseconds(metrics_.spin_budget_ns.get()),
+        };
+    }
+
+    SubmitStats Processor::getSubmitStats() const {
+        return {
+            .submits = metrics_.submits.get(),
+            .sqes = metrics_.sqes_submitted.get(),
+            .cq_overflows = metrics_.cq_overflows.get(),
+            .dropped_cqes = metrics_.dropped_cqes.get(),
+        };
+    }
+
     void Processor::execute() {
         spdlog::debug("Processor {}: Executing", id_);
-        while (true) {
-            bool has_job = execOnce();
-            if (rq_.size() != 0) {
+        auto* context = IOContext::getInstance();
+        auto last = std::chrono::steady_clock::now();
+        while (!context->isStopped()) {
+            execOnce();
+            auto now = std::chrono::steady_clock::now();
+            metrics_.busy_ns.add(static_cast<uint64_t>((now - last).count()));
+            last = now;
+            if (rq_.size() != 0 || runnext_ != nullptr || !coroutines_.empty() || !pinned_.empty()) {
+                resetSpinning();
                 continue;
             }
-
-            auto size = IOContext::getInstance()->stealTasks(id_, rq_);
-            if (size > 0) {
+            if (findTasks()) {
                 continue;
             }
-
-            if (!has_job && size == 0) {
-                std::this_thread::sleep_for(MAX_EVENT_WAIT);
+            if (pollCompletions()) {
+                continue;
             }
+            now = std::chrono::steady_clock::now();
+            metrics_.busy_ns.add(static_cast<uint64_t>((now - last).count()));
+            park();
+            last = std::chrono::steady_clock::now();
+            metrics_.idle_ns.add(static_cast<uint64_t>((last - now).count()));
         }
     }
 
-    bool Processor::execOnce() {
-        for (Task task = rq_.pop(); task != nullptr; task = rq_.pop()) {
+    void Processor::execOnce() {
+        if (has_unregistered_.load(std::memory_order_acquire)) [[unlikely]] {
+            drainUnregistered();
+        }
+        for (Task task = popTask(); task != nullptr; task = popTask()) {
             execTask(task);
         }
-
-        auto timeout = getNextTriggerDuration();
-        if (pending_ops_ == 0 && !timeout) {
-            return false;
+        // fibers yielding READY run again in the next round
+        for (auto n = pinned_.size(); n > 0; n--) {
+            auto* task = pinned_.front();
+            pinned_.pop();
+            execTask(task);
         }
-
-        std::chrono::system_clock::duration time = MAX_EVENT_WAIT;
-        if (timeout) {
-            time = min(time, *timeout);
+        while (!coroutines_.empty()) {
+            auto coroutine = coroutines_.front();
+            coroutines_.pop();
+            metrics_.context_switches.add();
+            coroutine.resume();
         }
 
-        waitEvent(time);
+        // submit new requests and reap completions without blocking
+        if (pending_ops_ != 0) {
+            waitEvent(std::chrono::seconds(0));
+        }
 
-        auto expired_cbs = getExpiredCallBacks();
-        for (const auto& cb : expired_cbs) {
+        getExpiredCallBacks(expired_cbs_);
+        for (const auto& cb : expired_cbs_) {
             execTask(cb);
         }
+        metrics_.timers_fired.add(expired_cbs_.size());
+        if (!expired_cbs_.empty()) {
+            trace(TraceEvent::TimerFire, 0, static_cast<int64_t>(expired_cbs_.size()));
+        }
+        metrics_.timers.set(getTimerCount());
+        expired_cbs_.clear();
+    }
+
+    bool Processor::findTasks() {
+        auto* context = IOContext::getInstance();
+        if (context->globalQueue(id_).steal(rq_) > 0) {
+            resetSpinning();
+            return true;
+        }
+        if (!spinning_) {
+            if (!context->startSpinning()) {
+                return false;
+            }
+            spinning_ = true;
+        }
+        metrics_.steal_attempts.add();
+        auto stolen = context->stealTasks(id_, rq_);
+        if (stolen == 0) {
+            return false;
+        }
+        metrics_.steal_successes.add();
+        metrics_.tasks_stolen.add(stolen);
+        resetSpinning();
         return true;
     }
 
-    void Processor::waitEvent(std::chrono::system_clock::duration timeout) {
+    void Processor::resetSpinning() {
+        if (!std::exchange(spinning_, false)) {
+            return;
+        }
+        // the last spinning processor found work, there may be more of it, let another one spin
+        auto* context = IOContext::getInstance();
+        if (context->nr_spinning_.fetch_sub(1) == 1) {
+            context->wakeProcessor();
+        }
+    }
+
+    bool Processor::pollCompletions() {
+        if (spin_max_.count() == 0 || pending_ops_ == 0) {
+            return false;
+        }
+        auto* context = IOContext::getInstance();
+        auto budget = std::chrono::nanoseconds(metrics_.spin_budget_ns.get());
+        auto deadline = std::chrono::steady_clock::now() + budget;
         struct io_uring_cqe* cqe = nullptr;
-        {
-            struct __kernel_timespec ts = durationToKernelTimespec(timeout);
-            int res = io_uring_submit_and_wait_timeout(&uring_, &cqe, 1, &ts, nullptr);
-            if (res == -ETIME) {
-                return;
-            }
-            if (res < 0) [[unlikely]] {
-                if (res != -EINTR) {
-                    throw std::system_error(-res, std::system_category());
-                }
-                return;
+        bool hit = false;
+        while (true) {
+            if (io_uring_peek_batch_cqe(&uring_, &cqe, 1) != 0 || context->globalQueue(id_).size() != 0) {
+                hit = true;
+                break;
             }
+            if (std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+            cpuRelax();
+        }
+
+        // keep spinning longer while it pays off, back off when completions take longer than the budget
+        constexpr double DECAY = 0.9;
+        spin_hit_rate_ = spin_hit_rate_ * DECAY + (hit ? 1 - DECAY : 0);
+        if (spin_hit_rate_ > 0.5) {
+            budget = std::min(budget * 2, spin_max_);
+        } else if (spin_hit_rate_ < 0.2) {
+            budget = std::max(budget / 2, spin_max_ / 64);
+        }
+        metrics_.spin_budget_ns.set(static_cast<uint64_t>(budget.count()));
+        (hit ? metrics_.spin_hits : metrics_.spin_misses).add();
+
+        if (hit) {
+            reapCompletions();
+        }
+        return hit;
+    }
+
+    void Processor::park() {
+        auto* context = IOContext::getInstance();
+        if (!context->parkProcessor(*this)) {
+            return;
+        }
+
+        if (!wakeup_armed_) {
+            armWakeup();
         }
+        waitEvent(getNextTriggerDuration());
+        context->unparkProcessor(*this);
+    }
+
+    void Processor::wakeup() { checkRet(eventfd_write(wakeup_fd_, 1)); }
 
+    void Processor::armWakeup() {
+        // the wakeup read isn't counted in pending_ops_, it is only armed right before parking
+        struct io_uring_sqe* sqe = allocSqe();
+        io_uring_prep_read(sqe, wakeup_fd_, &wakeup_buf_, sizeof(wakeup_buf_), 0);
+        io_uring_sqe_set_data64(sqe, WAKEUP_TAG);
+        wakeup_armed_ = true;
+    }
+
+    void Processor::waitEvent(std::optional<std::chrono::system_clock::duration> timeout) {
+        auto ready = io_uring_sq_ready(&uring_);
+        int res = 0;
+        if (timeout && *timeout <= std::chrono::system_clock::duration::zero()) {
+            // deferred completions are only posted when we ask for events
+            res = isSingleIssuer() ? io_uring_submit_and_get_events(&uring_) : io_uring_submit(&uring_);
+        } else {
+            struct io_uring_cqe* cqe = nullptr;
+            struct __kernel_timespec ts{};
+            if (timeout) {
+                ts = durationToKernelTimespec(*timeout);
+            }
+            res = io_uring_submit_and_wait_timeout(&uring_, &cqe, 1, timeout ? &ts : nullptr, nullptr);
+        }
+        // -EBUSY: the CQ ring overflowed, nothing is submitted until the completions are reaped below
+        if (res < 0 && res != -ETIME && res != -EINTR && res != -EBUSY) [[unlikely]] {
+            throw std::system_error(-res, std::system_category());
+        }
+        if (res >= 0 || res == -ETIME) {
+            countSubmit(ready);
+        }
+
+        reapCompletions();
+
+        // let idle processors steal what we can't run right now
+        if (rq_.size() > 1) {
+            IOContext::getInstance()->wakeProcessor();
+        }
+    }
+
+    void Processor::reapCompletions() {
+        reaping_ = true;
+        struct io_uring_cqe* cqe = nullptr;
         unsigned head{};
         unsigned num{};
+        unsigned ops{};
         io_uring_for_each_cqe(&uring_, head, cqe) {
-            auto* data = static_cast<UringOp::UringData*>(io_uring_cqe_get_data(cqe));
-            data->res_ = cqe->res;
-            emplaceTask(data->fiber_);
             ++num;
+            auto user_data = io_uring_cqe_get_data64(cqe);
+            switch (user_data & TAG_MASK) {
+            case WAKEUP_TAG:
+                wakeup_armed_ = false;
+                break;
+            case POST_TAG:
+                ++ops;
+                if (cqe->res < 0) [[unlikely]] {
+                    // the target ring can't take it (e.g. CQ overflow), hand the fiber to anyone
+                    spdlog::warn("Processor {}: post failed: {}", id_, strerror(-cqe->res));
+                    IOContext::getInstance()->emplaceTask(untagged(user_data));
+                    IOContext::getInstance()->wakeProcessor();
+                }
+                break;
+            case POSTED_TAG:
+                emplaceTask(untagged(user_data));
+                break;
+            case HANDLER_TAG:
+                // a multishot op stays pending until the kernel drops it
+                if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                    ++ops;
+                }
+                untagged<UringHandler>(user_data)->complete(cqe);
+                break;
+            default: {
+                auto* data = static_cast<UringOp::UringData*>(io_uring_cqe_get_data(cqe));
+                if (!(cqe->flags & IORING_CQE_F_NOTIF)) {
+                    data->res_ = cqe->res;
+                }
+                // e.g. a zero-copy send, its buffer is in use until the notification CQE
+                if (cqe->flags & IORING_CQE_F_MORE) {
+                    break;
+                }
+                if (data->coroutine_) {
+                    trace(TraceEvent::Complete, data->coroutine_.address(), cqe->res);
+                    emplaceCoroutine(data->coroutine_);
+                } else {
+                    trace(TraceEvent::Complete, data->fiber_, cqe->res);
+                    ready(data->fiber_, data->handoff_);
+                }
+                ++ops;
+            }
+            }
         }
         io_uring_cq_advance(&uring_, num);
-        pending_ops_ -= static_cast<std::size_t>(num);
+        pending_ops_ -= static_cast<std::size_t>(ops);
+        metrics_.cqes_reaped.add(num);
+        reaping_ = false;
+
+        auto dropped = *uring_.cq.koverflow;
+        if (dropped != metrics_.dropped_cqes.get()) [[unlikely]] {
+            spdlog::error("Processor {}: {} completions dropped, raise cq_entries", id_, dropped);
+            metrics_.dropped_cqes.set(dropped);
+        }
+        // the completions which didn't fit wait in the kernel, flush them into the room we just made
+        if (io_uring_cq_has_overflow(&uring_)) [[unlikely]] {
+            metrics_.cq_overflows.add();
+            io_uring_get_events(&uring_);
+            reapCompletions();
+        }
+    }
+
+    void Processor::post(Task task, uint64_t target_id) {
+        auto* context = IOContext::getInstance();
+        auto* processor = getProcessor();
+        if (processor == nullptr) {
+            // only a processor has a ring to send the message from
+            context->emplaceTask(task);
+            context->wakeProcessor();
+            return;
+        }
+        if (target_id == processor->id_) {
+            processor->emplaceTask(task);
+            return;
+        }
+
+        // submitted with the sender's next batch, the CQE shows up on the target's ring and wakes it up if parked
+        auto* target = context->processors_.at(target_id);
+        struct io_uring_sqe* sqe = processor->getSqe();
+        io_uring_prep_msg_ring(sqe, target->uring_.ring_fd, 0, tagged(task, POSTED_TAG), 0);
+        io_uring_sqe_set_data64(sqe, tagged(task, POST_TAG));
+    }
+
+    struct io_uring_sqe* Processor::getSqe(UringHandler* handler) {
+        struct io_uring_sqe* sqe = getSqe();
+        io_uring_sqe_set_data64(sqe, getUserData(handler));
+        return sqe;
+    }
+
+    uint64_t Processor::getUserData(UringHandler* handler) { return tagged(handler, HANDLER_TAG); }
+
+    void Processor::pin() {
+        assertThat(getProcessor() != nullptr && Fiber::getCurrentFiber() != &t_processor_fiber,
+                   "pin must be called in a fiber");
+        Fiber::getCurrentFiber()->pinned_ = getProcessorID();
+    }
+
+    void Processor::unpin() { Fiber::getCurrentFiber()->pinned_.reset(); }
+
+    Processor::Task Processor::buildTask(Func const& func, SpawnOptions const& options) {
+        auto* task = buildTask(func, options.stack_size != 0 ? options.stack_size : stack_size_);
+        auto target = options.processor.value_or(id_);
+        if (options.affinity == Affinity::Pinned) {
+            task->pinned_ = target;
+        } else if (options.affinity == Affinity::Soft) {
+            task->home_ = target;
+        }
+        return task;
+    }
+
+    void Processor::ready(Task task, bool next) {
+        auto* processor = getProcessor();
+        auto target = task->pinned_ ? task->pinned_ : task->home_;
+        if (processor == nullptr || (target && *target != processor->id_)) {
+            post(task, target.value_or(0));
+            return;
+        }
+        if (!next) {
+            processor->emplaceTask(task);
+            return;
+        }
+        if (auto* previous = std::exchange(processor->runnext_, task)) {
+            processor->emplaceTask(previous);
+        }
+    }
+
+    Processor::Task Processor::popTask() {
+        if (runnext_ != nullptr) {
+            if (runnext_streak_ < MAX_RUNNEXT_STREAK) {
+                ++runnext_streak_;
+                return std::exchange(runnext_, nullptr);
+            }
+            emplaceTask(std::exchange(runnext_, nullptr));
+        }
+        runnext_streak_ = 0;
+        return rq_.pop();
+    }
+
+    Processor::Task Processor::buildPinnedTask(Func const& func, uint64_t target_id) {
+        auto* task = buildTask(func, stack_size_);
+        task->pinned_ = target_id;
+        return task;
+    }
+
+    void Processor::switchTo(uint64_t target_id) {
+        auto* processor = getProcessor();
+        assertThat(processor != nullptr && Fiber::getCurrentFiber() != &t_processor_fiber,
+                   "switchTo must be called in a fiber");
+        if (processor->id_ == target_id) {
+            return;
+        }
+        auto* fiber = Fiber::getCurrentFiber();
+        // pinned until it runs on the target, a thief taking it from the run queue there would resume it elsewhere
+        bool pinned = fiber->pinned_.has_value();
+        fiber->pinned_ = target_id;
+        processor->switch_to_ = target_id;
+        Fiber::yield();
+        if (!pinned) {
+            fiber->pinned_.reset();
+        }
+    }
+
+    void Processor::suspend(void (*release)(void*), void* arg) {
+        auto* processor = getProcessor();
+        assertThat(processor != nullptr && Fiber::getCurrentFiber() != &t_processor_fiber,
+                   "suspend must be called in a fiber");
+        processor->release_ = release;
+        processor->release_arg_ = arg;
+        Fiber::yield();
+    }
+
+    void Processor::unregisterFile(uint64_t owner, unsigned index) {
+        auto* processor = IOContext::getInstance()->processors_.at(owner);
+        if (processor == nullptr) {
+            return;
+        }
+        if (processor->isSingleIssuer() && processor != getProcessor()) {
+            {
+                std::lock_guard<std::mutex> lock(processor->unregister_mutex_);
+                processor->unregistered_.push_back(index);
+                processor->has_unregistered_.store(true, std::memory_order_release);
+            }
+            processor->wakeup();
+            return;
+        }
+        int fd = -1;
+        int ret = io_uring_register_files_update(&processor->uring_, index, &fd, 1);
+        if (ret < 0) [[unlikely]] {
+            spdlog::warn("Processor {}: unregister file {}: {}", owner, index, strerror(-ret));
+        }
+    }
+
+    Pipe Processor::acquirePipe() {
+        if (pipes_.empty()) {
+            return Pipe();
+        }
+        auto pipe = std::move(pipes_.back());
+        pipes_.pop_back();
+        return pipe;
+    }
+
+    void Processor::releasePipe(Pipe pipe) {
+        if (pipes_.size() < MAX_CACHED_PIPES) {
+            pipes_.push_back(std::move(pipe));
+        }
+    }
+
+    void Processor::drainUnregistered() {
+        std::vector<unsigned> indexes;
+        {
+            std::lock_guard<std::mutex> lock(unregister_mutex_);
+            indexes.swap(unregistered_);
+            has_unregistered_.store(false, std::memory_order_relaxed);
+        }
+        for (auto index : indexes) {
+            unregisterFile(id_, index);
+        }
+    }
+
+    void Processor::emplaceTask(Task task) {
+        if (task->pinned_) [[unlikely]] {
+            if (*task->pinned_ != id_) {
+                post(task, *task->pinned_);
+            } else {
+                pinned_.push(task);
+            }
+            return;
+        }
+        if (!rq_.emplace(task)) [[unlikely]] {
+            IOContext::getInstance()->emplaceTask(task);
+        }
     }
 
     void Processor::execTask(Task task) {
+        // pinned elsewhere, e.g. spawned from outside of the runtime and picked up from the global queue
+        if (task->pinned_ && *task->pinned_ != id_) [[unlikely]] {
+            post(task, *task->pinned_);
+            return;
+        }
+        metrics_.context_switches.add();
         task->resume();
 
+        if (switch_to_) {
+            post(task, *std::exchange(switch_to_, std::nullopt));
+            return;
+        }
+        if (release_ != nullptr) {
+            // the fiber may be running on another processor as soon as this returns
+            std::exchange(release_, nullptr)(release_arg_);
+            return;
+        }
+
         auto state = task->state_;
         if (state == Fiber::READY) {
             emplaceTask(task);
         } else if (state == Fiber::TERM || state == Fiber::EXCEPT) {
+            trace(TraceEvent::FiberTerm, task, state);
             rq_.emplace_free(task);
         }
     }
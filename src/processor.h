@@ -1,33 +1,98 @@
 #pragma once
 
+#include "detail/buffer_ring.h"
 #include "detail/fiber.h"
+#include "detail/pipe.h"
 #include "detail/timer.h"
+#include "metrics.h"
+#include "options.h"
 #include "runqueue.h"
+#include "tracer.h"
 
+#include <coroutine>
 #include <cstdint>
 #include <liburing.h>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <vector>
 #include <spdlog/spdlog.h>
 
-static constexpr unsigned int RING_SIZE = 256;
-static constexpr uint64_t MAX_TASKQUEUE_SIZE = 256;
+static constexpr uint64_t MAX_TASKQUEUE_SIZE = sylar::RunQueue::CAPACITY;
+static constexpr std::size_t MAX_CACHED_PIPES = 16;
 namespace sylar {
+    struct UringHandler;
+
     class Processor : public TimerManager {
     public:
         using Func = std::function<void()>;
         using Task = Fiber*;
 
-        explicit Processor(uint64_t id, bool hook = false, unsigned int entries = RING_SIZE);
+        // with RingMode::SqPoll, attach_fd is the ring whose SQ thread is shared, -1 to start a new one
+        explicit Processor(uint64_t id, IOContextOptions const& options = {}, int attach_fd = -1);
         ~Processor();
 
         void execute();
 
-        void emplaceTask(Func const& func) { rq_.emplace(func); }
-        void emplaceTask(Task task) { rq_.emplace(task); }
+        void emplaceTask(Func const& func) { emplaceTask(buildTask(func, stack_size_)); }
+        void emplaceTask(Func const& func, uint32_t stack_size) { emplaceTask(buildTask(func, stack_size)); }
+        // push the task into the global queue if local queue is full
+        void emplaceTask(Task task);
         size_t stealTasks(RunQueue& rq) { return rq_.steal(rq, false); }
 
+        // coroutines are resumed by the processor which runs them, they are never stolen
+        void emplaceCoroutine(std::coroutine_handle<> coroutine) { coroutines_.push(coroutine); }
+
+        // Hand a suspended fiber over to the processor target_id through IORING_OP_MSG_RING, the target drains it
+        // with its I/O completions. The fiber must not be running, it may be resumed as soon as the message is
+        // submitted. Outside of a processor the fiber is pushed into the global queue instead.
+        static void post(Task task, uint64_t target_id);
+
+        // an SQE whose CQEs are handed to handler instead of resuming a fiber, the op is pending until its last CQE
+        struct io_uring_sqe* getSqe(UringHandler* handler);
+        // user data of the SQEs of handler, e.g. to cancel them
+        static uint64_t getUserData(UringHandler* handler);
+
+        // Make a woken up fiber runnable: a pinned fiber or one with a home goes to its processor, the others stay on
+        // the current one. With next it goes into the run next slot and runs before the run queue, for a handoff
+        // from the waking fiber as in a producer/consumer pair.
+        static void ready(Task task, bool next = false);
+
+        // pin the current fiber to the current processor, it is neither stolen nor posted elsewhere until unpinned
+        static void pin();
+        static void unpin();
+        // build a fiber which only runs on processor target_id, it still has to be spawned
+        Task buildPinnedTask(Func const& func, uint64_t target_id);
+
+        // Move the current fiber to the processor target_id, it continues there once the target drains the post and
+        // is on target_id when this returns, it can't be stolen on the way. A pinned fiber stays pinned, to target_id.
+        static void switchTo(uint64_t target_id);
+
+        // Switch out the current fiber and call release(arg) once it is, e.g. to unlock the wait queue it went into.
+        // A waker which finds the fiber in the queue can then make it ready without racing with its switch out.
+        static void suspend(void (*release)(void*), void* arg);
+
+        // whether accepted sockets and opened files go into the registered file table
+        bool hasFixedFiles() const { return fixed_files_ != 0; }
+        // close the slot index of the registered file table of processor owner, may be called from any thread
+        static void unregisterFile(uint64_t owner, unsigned index);
+
+        // provided buffers for multishot recv, nullptr if disabled
+        BufferRing* getBufferRing() const { return buffer_ring_.get(); }
+
+        // a pipe for splice, from the cache of the processor if there is one
+        Pipe acquirePipe();
+        // give an empty pipe back to the cache, a pipe holding data must be dropped instead
+        void releasePipe(Pipe pipe);
+
         uint64_t getPendingOps() const { return pending_ops_; }
+        // may be called from any thread
+        ProcessorSnapshot getMetrics() const;
+        SubmitStats getSubmitStats() const;
+        SpinStats getSpinStats() const;
 
-        bool isFull() { return rq_.size() >= MAX_TASKQUEUE_SIZE; }
+        bool isFull() const { return rq_.size() >= MAX_TASKQUEUE_SIZE; }
 
         // get current thread's processor
         static Processor* getProcessor() { return t_processor; }
@@ -35,23 +100,104 @@ namespace sylar {
         static Fiber* getProcessorFiber() { return &t_processor_fiber; }
 
     private:
-        bool execOnce();
-
-        void execTask(Func const& func) { execTask(rq_.buildTask(func)); }
+        void execOnce();
+        // the run next slot, then the run queue
+        Task popTask();
+
+        Task buildTask(Func const& func, uint32_t stack_size) {
+            bool reused = false;
+            auto* task = rq_.buildTask(func, stack_size, reused);
+            (reused ? metrics_.fibers_reused : metrics_.fibers_created).add();
+            trace(TraceEvent::FiberCreate, task);
+            return task;
+        }
+        Task buildTask(Func const& func, SpawnOptions const& options);
+
+        void execTask(Func const& func) { execTask(buildTask(func, stack_size_)); }
         void execTask(Task);
 
-        void waitEvent(std::chrono::system_clock::duration);
-
+        // look for tasks in the global queue and other processors
+        bool findTasks();
+        // A spinning processor found work, from any source: it stops spinning and, if it was the last one, wakes up
+        // another processor to look for more, like resetspinning in Go.
+        void resetSpinning();
+        // spin on the CQ ring and the global queue within the budget, return true if something showed up
+        bool pollCompletions();
+        // block in io_uring until an I/O completion, a timer or a wakeup from a spawner
+        void park();
+        // called by other threads to wake up a parked processor
+        void wakeup();
+        void armWakeup();
+
+        void initRing(IOContextOptions const& options, int attach_fd);
+        bool isSqPoll() const { return (uring_.flags & IORING_SETUP_SQPOLL) != 0; }
+        bool isSingleIssuer() const { return (uring_.flags & IORING_SETUP_SINGLE_ISSUER) != 0; }
+        // close the slots unregistered by other threads, a single issuer ring only takes them from its own thread
+        void drainUnregistered();
+
+        // wait for completions, std::nullopt means waiting without timeout
+        void waitEvent(std::optional<std::chrono::system_clock::duration> timeout);
+        // submit without waiting, a full CQ ring is reaped first
+        void submit();
+        void countSubmit(unsigned sqes);
+        // handle the completions in the CQ ring and flush the overflow backlog into it
+        void reapCompletions();
+
+        friend class IOContext;
         friend struct UringOp;
         struct io_uring_sqe* getSqe();
+        struct io_uring_sqe* allocSqe();
 
         uint64_t id_;
+        uint32_t stack_size_;
+        unsigned fixed_files_{};
+        std::unique_ptr<BufferRing> buffer_ring_;
+        std::vector<Pipe> pipes_;
 
         io_uring uring_{};
 
         std::atomic<uint64_t> pending_ops_;
 
+        unsigned submit_batch_{};
+        // the last SQE handed out, a batch is not submitted in the middle of a link chain
+        struct io_uring_sqe* last_sqe_{};
+        bool reaping_{false};
+
+        // adaptive busy polling, the hit rate is a moving average over the recent polls, the budget is in metrics_
+        std::chrono::nanoseconds spin_max_{};
+        double spin_hit_rate_{};
+
+        std::mutex unregister_mutex_;
+        std::vector<unsigned> unregistered_;
+        std::atomic<bool> has_unregistered_{false};
+
+        ProcessorMetrics metrics_;
+
         RunQueue rq_;
+        // a fiber handed over by the running one, it isn't visible to the thieves. A chain of handoffs is cut after
+        // MAX_RUNNEXT_STREAK so that the run queue isn't starved.
+        Task runnext_{};
+        unsigned runnext_streak_{};
+        static constexpr unsigned MAX_RUNNEXT_STREAK = 16;
+        std::queue<std::coroutine_handle<>> coroutines_;
+        // fibers pinned to this processor, kept out of reach of the thieves
+        std::queue<Task> pinned_;
+        // reused across rounds to avoid an allocation per round
+        std::vector<Func> expired_cbs_;
+        // set by switchTo, the fiber is posted once it is switched out
+        std::optional<uint64_t> switch_to_;
+        // set by suspend, called once the fiber is switched out
+        void (*release_)(void*){};
+        void* release_arg_{};
+
+        // an eventfd read is armed on the ring while parked, spawners write the eventfd to wake us up
+        int wakeup_fd_{-1};
+        uint64_t wakeup_buf_{};
+        bool wakeup_armed_{false};
+
+        // the fields below are guarded by IOContext::idle_mutex_ while the processor is parked
+        bool spinning_{false};
+        bool idle_{false};
 
         static inline thread_local Processor* t_processor{};
         static inline thread_local Fiber t_processor_fiber{};
@@ -2,78 +2,183 @@
 
 #include "detail/fiber.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <mutex>
 #include <queue>
+#include <vector>
 
 namespace sylar {
+    // Bounded lock-free run queue of a processor, only the owner thread pushes and pops, other processors steal.
+    // Chase-Lev style: the owner publishes new tasks through tail_, consumers (owner pop and thieves) claim tasks
+    // by CAS on head_, a thief claims half of the queue with a single CAS.
+    // Tasks are consumed in FIFO order (like Go's local run queue) rather than Chase-Lev's LIFO owner pop, since a
+    // fiber yielding with READY must not be resumed again before the others.
     class RunQueue {
     public:
         using Func = std::function<void()>;
         using Task = Fiber*;
 
-        void emplace(Task task) {
-            std::lock_guard<std::mutex> lock(mutex_);
-            tasks_.push(task);
-        }
-        void emplace(Func const& func) {
-            std::lock_guard<std::mutex> lock(mutex_);
-            tasks_.push(buildTask(func));
+        static constexpr uint32_t CAPACITY = 256;
+        // terminated fibers kept for reuse, the rest give their stacks back to the stack allocator
+        static constexpr size_t MAX_FREE_TASKS = 64;
+        // only the last freed keep the pages of their stacks, a burst of exits doesn't stay resident
+        static constexpr size_t MAX_RESIDENT_FREE_TASKS = 8;
+
+        // owner only, return false if the queue is full
+        bool emplace(Task task) {
+            auto head = head_.load(std::memory_order_acquire);
+            auto tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head >= CAPACITY) {
+                return false;
+            }
+            tasks_[tail % CAPACITY].store(task, std::memory_order_relaxed);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
         }
 
         // free tasks only be used in local thread, lock isn't needed here
-        void emplace_free(Task task) { free_tasks_.push(task); }
-
-        // get a task from the free queue or create a new one
-        Task buildTask(Func const& func) {
-            Task task = nullptr;
-            if (!free_tasks_.empty()) {
-                task = free_tasks_.front();
-                free_tasks_.pop();
-                task->reset(func);
-            } else {
-                task = Fiber::newFiber(func);
+        void emplace_free(Task task) {
+            if (free_tasks_.size() >= MAX_FREE_TASKS) {
+                delete task;
+                return;
+            }
+            // the one dropping out of the last MAX_RESIDENT_FREE_TASKS
+            if (free_tasks_.size() >= MAX_RESIDENT_FREE_TASKS) {
+                StackAllocator::release(free_tasks_[free_tasks_.size() - MAX_RESIDENT_FREE_TASKS]->stack_);
+            }
+            free_tasks_.push_back(task);
+        }
+
+        // get a task from the free list or create a new one, reused tells which
+        Task buildTask(Func const& func, uint32_t stack_size, bool& reused) {
+            auto it = findFreeTask(stack_size);
+            reused = it != free_tasks_.rend();
+            if (!reused) {
+                return Fiber::newFiber(func, stack_size);
             }
+            auto* task = *it;
+            free_tasks_.erase(std::next(it).base());
+            task->reset(func);
             return task;
         }
 
-        // steal half of tasks
+        // steal half of tasks into rq, called by the owner of rq
         size_t steal(RunQueue& rq, bool stealRunNext) {
-            std::scoped_lock lock(mutex_, rq.mutex_);
-            if (tasks_.empty()) {
-                return 0;
-            }
-            if (tasks_.size() == 1 && !stealRunNext) {
-                return 0;
+            while (true) {
+                auto head = head_.load(std::memory_order_acquire);
+                auto tail = tail_.load(std::memory_order_acquire);
+                auto size = tail - head;
+                if (size == 0) {
+                    return 0;
+                }
+                // head and tail are read separately, retry on an inconsistent snapshot
+                if (size > CAPACITY) {
+                    continue;
+                }
+                if (size == 1 && !stealRunNext) {
+                    return 0;
+                }
+
+                auto len = std::min((size + 1) / 2, rq.capacityLeft());
+                if (len == 0) {
+                    return 0;
+                }
+                auto rq_tail = rq.tail_.load(std::memory_order_relaxed);
+                for (uint32_t i = 0; i < len; i++) {
+                    auto task = tasks_[(head + i) % CAPACITY].load(std::memory_order_relaxed);
+                    rq.tasks_[(rq_tail + i) % CAPACITY].store(task, std::memory_order_relaxed);
+                }
+                // tasks copied above are only valid if no other consumer claimed them in the meantime
+                if (head_.compare_exchange_strong(head, head + len, std::memory_order_acq_rel,
+                                                  std::memory_order_relaxed)) {
+                    rq.tail_.store(rq_tail + len, std::memory_order_release);
+                    return len;
+                }
             }
+        }
 
-            auto len = (tasks_.size() + 1) / 2;
-            for (size_t i = 0; i < len; i++) {
-                rq.tasks_.push(tasks_.front());
-                tasks_.pop();
+        size_t size() const {
+            auto head = head_.load(std::memory_order_acquire);
+            auto tail = tail_.load(std::memory_order_acquire);
+            return tail - head > CAPACITY ? 0 : tail - head;
+        }
+
+        // owner only
+        Task pop() {
+            auto head = head_.load(std::memory_order_acquire);
+            while (true) {
+                auto tail = tail_.load(std::memory_order_relaxed);
+                if (tail == head) {
+                    return nullptr;
+                }
+                auto task = tasks_[head % CAPACITY].load(std::memory_order_relaxed);
+                if (head_.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel,
+                                                std::memory_order_acquire)) {
+                    return task;
+                }
             }
-            return len;
         }
 
-        size_t size() {
+    private:
+        // owner only
+        uint32_t capacityLeft() const {
+            return CAPACITY - (tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_acquire));
+        }
+
+        alignas(64) std::atomic<uint32_t> head_{0};
+        alignas(64) std::atomic<uint32_t> tail_{0};
+        alignas(64) std::array<std::atomic<Task>, CAPACITY> tasks_{};
+        // taken from the back, the last freed are the ones whose stacks are still resident
+        std::vector<Task> free_tasks_;
+
+        std::vector<Task>::const_reverse_iterator findFreeTask(uint32_t stack_size) const {
+            return std::find_if(free_tasks_.rbegin(), free_tasks_.rend(),
+                                [stack_size](Task task) { return task->getStackSize() == stack_size; });
+        }
+    };
+
+    // Unbounded queue shared by all processors, tasks spawned from outside the processors or overflowed from a full
+    // local queue end up here
+    class GlobalRunQueue {
+    public:
+        using Func = std::function<void()>;
+        using Task = Fiber*;
+
+        void emplace(Task task) {
             std::lock_guard<std::mutex> lock(mutex_);
-            return tasks_.size();
+            tasks_.push(task);
+            size_.store(tasks_.size(), std::memory_order_relaxed);
         }
+        void emplace(Func const& func, uint32_t stack_size) { emplace(Fiber::newFiber(func, stack_size)); }
 
-        Task pop() {
+        // steal half of tasks into rq, called by the owner of rq
+        size_t steal(RunQueue& rq) {
+            if (size_.load(std::memory_order_relaxed) == 0) {
+                return 0;
+            }
             std::lock_guard<std::mutex> lock(mutex_);
-            if (tasks_.empty()) {
-                return nullptr;
+            auto len = (tasks_.size() + 1) / 2;
+            size_t i = 0;
+            for (; i < len; i++) {
+                if (!rq.emplace(tasks_.front())) {
+                    break;
+                }
+                tasks_.pop();
             }
-            Task task = tasks_.front();
-            tasks_.pop();
-            return task;
+            size_.store(tasks_.size(), std::memory_order_relaxed);
+            return i;
         }
 
+        size_t size() const { return size_.load(std::memory_order_relaxed); }
+
     private:
         std::mutex mutex_;
         std::queue<Task> tasks_;
-        std::queue<Task> free_tasks_;
+        std::atomic<size_t> size_{0};
     };
 
 } // namespace sylar
@@ -16,6 +16,10 @@ namespace sylar {
             return static_cast<size_t>(checkRetUring(file_write(file_, buffer)));
         }
 
+        std::size_t raw_writev(std::span<struct iovec const> iov) override {
+            return static_cast<size_t>(checkRetUring(file_writev(file_, iov)));
+        }
+
         void raw_close() override { file_close(std::move(file_)); }
 
         FileHandle release() noexcept { return std::move(file_); }
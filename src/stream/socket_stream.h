@@ -7,6 +7,13 @@
 namespace sylar {
     struct SocketStream : Stream {
         explicit SocketStream(SocketHandle file) : file_(std::move(file)) {}
+        ~SocketStream() override {
+            // the provided buffers can't be given back while the kernel may still complete into the handler
+            if (recv_ && !recv_->stop()) {
+                spdlog::warn("multishot recv is still armed, leaking it");
+                (void)recv_.release();
+            }
+        }
 
         std::size_t raw_read(std::span<char> buffer) override {
             return static_cast<size_t>(checkRetUring(socket_read(file_, buffer, timeout_)));
@@ -15,14 +22,35 @@ namespace sylar {
         std::size_t raw_write(std::span<char const> buffer) override {
             return static_cast<size_t>(checkRetUring(socket_write(file_, buffer, timeout_)));
         }
+        std::size_t raw_writev(std::span<struct iovec const> iov) override {
+            return static_cast<size_t>(checkRetUring(socket_writev(file_, iov, timeout_)));
+        }
+
+        std::size_t raw_write_zerocopy(std::span<char const> buffer) override {
+            return static_cast<size_t>(socket_send_zc(file_, buffer, timeout_));
+        }
+
         void raw_timeout(UringOp::timeout_type timeout) override { timeout_ = timeout; }
 
+        // multishot recv into the provided buffers of the processor if it has some
+        std::optional<std::span<char const>> raw_borrow() override {
+            if (!recv_) {
+                auto* processor = Processor::getProcessor();
+                if (processor == nullptr || processor->getBufferRing() == nullptr) {
+                    return std::nullopt;
+                }
+                recv_ = std::make_unique<MultishotRecv>();
+            }
+            return recv_->recv(file_, timeout_);
+        }
+
         SocketHandle release() noexcept { return std::move(file_); }
         SocketHandle& get() noexcept { return file_; }
 
     private:
         UringOp::timeout_type timeout_;
         SocketHandle file_;
+        std::unique_ptr<MultishotRecv> recv_;
     };
 
 } // namespace sylar
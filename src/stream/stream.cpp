@@ -7,7 +7,7 @@ namespace sylar {
             index_end_ = index_in_ = 0;
             fillbuf();
         }
-        char c = buffer_in_[index_in_];
+        char c = data_in_[index_in_];
         ++index_in_;
         return c;
     }
@@ -18,11 +18,11 @@ namespace sylar {
         while (true) {
             auto end = start + n;
             if (end <= index_end_) {
-                p = std::copy(buffer_in_.data() + start, buffer_in_.data() + end, p);
+                p = std::copy(data_in_ + start, data_in_ + end, p);
                 index_in_ = end;
                 return;
             }
-            p = std::copy(buffer_in_.data() + start, buffer_in_.data() + index_end_, p);
+            p = std::copy(data_in_ + start, data_in_ + index_end_, p);
             index_end_ = index_in_ = 0;
             fillbuf();
             start = 0;
@@ -32,13 +32,13 @@ namespace sylar {
         std::size_t start = index_in_;
         while (true) {
             for (std::size_t i = start; i < index_end_; ++i) {
-                if (buffer_in_[i] == eol) {
-                    s.append(buffer_in_.data() + start, i - start);
+                if (data_in_[i] == eol) {
+                    s.append(data_in_ + start, i - start);
                     index_in_ = i + 1;
                     return;
                 }
             }
-            s.append(buffer_in_.data() + start, index_end_ - start);
+            s.append(data_in_ + start, index_end_ - start);
             index_end_ = index_in_ = 0;
             fillbuf();
             start = 0;
@@ -48,7 +48,7 @@ namespace sylar {
         std::size_t start = index_in_;
         try {
             while (true) {
-                s.append(buffer_in_.data() + start, index_end_ - start);
+                s.append(data_in_ + start, index_end_ - start);
                 start = 0;
                 index_end_ = index_in_ = 0;
                 fillbuf();
@@ -87,7 +87,7 @@ namespace sylar {
         std::size_t start = index_in_;
         while (true) {
             for (std::size_t i = start; i < index_end_; ++i) {
-                if (buffer_in_[i] == eol) {
+                if (data_in_[i] == eol) {
                     index_in_ = i + 1;
                     return;
                 }
@@ -129,13 +129,38 @@ namespace sylar {
             auto* const be = buffer_out_.data() + buffer_out_.size();
             index_out_ = buffer_out_.size();
             std::memcpy(b, p, static_cast<size_t>(be - b));
+            p += be - b;
             flush();
             index_out_ = 0;
         }
     }
+    void BorrowedStream::put_zerocopy(std::span<char const> s) {
+        flush();
+        while (!s.empty()) {
+            auto len = stream_->raw_write_zerocopy(s);
+            if (len == 0) [[unlikely]] {
+                throw Stream::EOFException();
+            }
+            s = s.subspan(len);
+        }
+    }
+    void BorrowedStream::put_ref(std::span<char const> s) {
+        if (index_out_ > index_gather_) {
+            iov_out_.push_back({buffer_out_.data() + index_gather_, index_out_ - index_gather_});
+            index_gather_ = index_out_;
+        }
+        iov_out_.push_back({const_cast<char*>(s.data()), s.size()});
+        if (iov_out_.size() >= STREAM_GATHER_SIZE) {
+            flush();
+        }
+    }
     void BorrowedStream::flush() {
+        // the first flush allocates the output buffer, even when the output so far was only put_ref segments
         if (!buffer_out_) {
             alloc_bufout(STREAM_BUFFER_SIZE);
+        }
+        if (!iov_out_.empty()) {
+            flushv();
             return;
         }
         if (index_out_) [[likely]] {
@@ -153,10 +178,101 @@ namespace sylar {
         }
     }
 
+    void BorrowedStream::flushv() {
+        if (index_out_ > index_gather_) {
+            iov_out_.push_back({buffer_out_.data() + index_gather_, index_out_ - index_gather_});
+        }
+        auto iov = std::span(iov_out_);
+        while (!iov.empty()) {
+            auto len = stream_->raw_writev(iov);
+            if (len == 0) [[unlikely]] {
+                throw Stream::EOFException();
+            }
+            // drop what was written, the first segment left may be partly written
+            while (!iov.empty() && len >= iov.front().iov_len) {
+                len -= iov.front().iov_len;
+                iov = iov.subspan(1);
+            }
+            if (len > 0) {
+                iov.front().iov_base = static_cast<char*>(iov.front().iov_base) + len;
+                iov.front().iov_len -= len;
+            }
+        }
+        iov_out_.clear();
+        index_out_ = 0;
+        index_gather_ = 0;
+        stream_->raw_flush();
+    }
+
+    void BorrowedStream::fillmore() {
+        auto left = index_end_ - index_in_;
+        if (left == 0) {
+            // nothing to keep, a borrowed buffer is used in place. buffer_in_ only holds a partial request between
+            // two reads, once it drains a buffer grown for a large one goes back
+            if (buffer_in_.size() > STREAM_BUFFER_SIZE) {
+                buffer_in_ = BytesBuffer();
+            }
+            index_end_ = index_in_ = 0;
+            fillbuf();
+            return;
+        }
+        auto const* from = data_in_ + index_in_;
+        // only the partial bytes are copied, out of a borrowed buffer before raw_borrow gives it back
+        auto reserve = [&](std::size_t size) {
+            if (buffer_in_.size() >= size) {
+                if (left > 0 && from != buffer_in_.data()) {
+                    std::memmove(buffer_in_.data(), from, left);
+                }
+                return;
+            }
+            BytesBuffer bigger(std::max({size, 2 * buffer_in_.size(), STREAM_BUFFER_SIZE}));
+            if (left > 0) {
+                std::memcpy(bigger.data(), from, left);
+            }
+            buffer_in_ = std::move(bigger);
+        };
+        reserve(left + 1);
+        data_in_ = buffer_in_.data();
+        index_in_ = 0;
+        index_end_ = left;
+
+        if (auto borrowed = stream_->raw_borrow()) {
+            if (borrowed->empty()) [[unlikely]] {
+                throw Stream::EOFException();
+            }
+            if (left + borrowed->size() > buffer_in_.size()) {
+                from = buffer_in_.data();
+                reserve(left + borrowed->size());
+                data_in_ = buffer_in_.data();
+            }
+            std::memcpy(buffer_in_.data() + left, borrowed->data(), borrowed->size());
+            index_end_ = left + borrowed->size();
+            return;
+        }
+
+        auto n = stream_->raw_read(std::span(buffer_in_.data() + left, buffer_in_.size() - left));
+        if (n == 0) [[unlikely]] {
+            throw Stream::EOFException();
+        }
+        index_end_ = left + n;
+    }
+
     void BorrowedStream::fillbuf() {
+        // the borrowed buffer goes back once consumed, before waiting for more data
+        if (auto borrowed = stream_->raw_borrow()) {
+            if (borrowed->empty()) [[unlikely]] {
+                throw Stream::EOFException();
+            }
+            data_in_ = borrowed->data();
+            index_in_ = 0;
+            index_end_ = borrowed->size();
+            return;
+        }
+
         if (!buffer_in_) {
             alloc_bufin(STREAM_BUFFER_SIZE);
         }
+        data_in_ = buffer_in_.data();
         auto n = stream_->raw_read(std::span(buffer_in_.data() + index_in_, buffer_in_.size() - index_in_));
         if (n == 0) [[unlikely]] {
             throw Stream::EOFException();
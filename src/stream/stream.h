@@ -8,12 +8,17 @@
 #include <cstring>
 
 #include <memory>
+#include <optional>
 #include <span>
+#include <sys/uio.h>
 #include <system_error>
+#include <vector>
 
 namespace sylar {
 
     inline constexpr std::size_t STREAM_BUFFER_SIZE = 8192;
+    // segments queued by put_ref before they are flushed
+    inline constexpr std::size_t STREAM_GATHER_SIZE = 64;
 
     struct Stream {
         struct EOFException : std::exception {
@@ -36,8 +41,20 @@ namespace sylar {
             throw std::system_error(std::make_error_code(std::errc::not_supported));
         }
 
+        // gather write, may write only a part like raw_write
+        virtual std::size_t raw_writev(std::span<struct iovec const> iov) {
+            return raw_write({static_cast<char const*>(iov.front().iov_base), iov.front().iov_len});
+        }
+
+        // write without copying buffer when the stream can, buffer is released when it returns
+        virtual std::size_t raw_write_zerocopy(std::span<char const> buffer) { return raw_write(buffer); }
+
         virtual void raw_timeout(UringOp::timeout_type /*unused*/) {}
 
+        // Read into a buffer lent by the stream, valid until the next raw_borrow, empty at EOF.
+        // std::nullopt if the stream doesn't lend buffers, BorrowedStream reads into its own buffer then.
+        virtual std::optional<std::span<char const>> raw_borrow() { return std::nullopt; }
+
         Stream& operator=(Stream&&) = delete;
         virtual ~Stream() = default;
     };
@@ -83,20 +100,31 @@ namespace sylar {
 
         void put(char c);
         void put(std::span<char const> s);
+        // flush and write s bypassing the output buffer, without a copy if the stream supports it
+        void put_zerocopy(std::span<char const> s);
+        // queue s without copying it, it goes out with the buffered output in one gather write at the next flush,
+        // s must stay valid until then
+        void put_ref(std::span<char const> s);
         void putline(std::string_view s) {
             put(s);
             put('\n');
             flush();
         }
 
-        std::span<char const> peek() const noexcept { return {buffer_in_.data() + index_in_, index_end_ - index_in_}; }
+        std::span<char const> peek() const noexcept { return {data_in_ + index_in_, index_end_ - index_in_}; }
         std::string getsome();
+        // Read more input after what peek() returns, which moves to the start of the input buffer, the buffer grows
+        // if it is full. With nothing left to peek, a buffer lent by the stream is read in place. Spans returned by
+        // peek() before are invalidated.
+        void fillmore();
 
         void seek(std::uint64_t pos) {
             stream_->raw_seek(pos);
             index_in_ = 0;
             index_end_ = 0;
             index_out_ = 0;
+            index_gather_ = 0;
+            iov_out_.clear();
         }
         void flush();
         void close() { stream_->raw_close(); }
@@ -111,11 +139,14 @@ namespace sylar {
 
     private:
         void fillbuf();
+        // flush the segments queued by put_ref with the buffered output
+        void flushv();
         void seenbuf(std::size_t n) noexcept { index_in_ += n; }
 
         void alloc_bufin(std::size_t size) {
             if (!buffer_in_) [[likely]] {
                 buffer_in_.allocate(size);
+                data_in_ = buffer_in_.data();
                 index_in_ = 0;
                 index_end_ = 0;
             }
@@ -131,10 +162,16 @@ namespace sylar {
         bool buffull() const noexcept { return index_out_ == buffer_out_.size(); }
 
         BytesBuffer buffer_in_;
+        // buffer_in_ or a buffer borrowed from the stream
+        char const* data_in_ = nullptr;
         std::size_t index_in_ = 0;
         std::size_t index_end_ = 0;
         BytesBuffer buffer_out_;
         std::size_t index_out_ = 0;
+        // segments queued by put_ref and the buffered output in between, buffer_out_ from index_gather_ on isn't
+        // in it yet
+        std::vector<struct iovec> iov_out_;
+        std::size_t index_gather_ = 0;
         Stream* stream_;
     };
 
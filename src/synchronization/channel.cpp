@@ -0,0 +1,161 @@
+#include "channel.h"
+
+#include "io_context.h"
+#include "processor.h"
+
+#include <algorithm>
+#include <array>
+#include <mutex>
+
+namespace sylar {
+    namespace {
+        // the locks of the channels of a select, taken in address order so that two selects can't deadlock
+        class LockSet {
+        public:
+            void add(SpinLock* lock) { locks_[size_++] = lock; }
+            void sort() {
+                auto end = locks_.begin() + static_cast<std::ptrdiff_t>(size_);
+                std::sort(locks_.begin(), end);
+                size_ = static_cast<std::size_t>(std::unique(locks_.begin(), end) - locks_.begin());
+            }
+
+            void lock() {
+                for (std::size_t i = 0; i < size_; i++) {
+                    locks_[i]->lock();
+                }
+            }
+            void unlock() {
+                for (std::size_t i = size_; i > 0; i--) {
+                    locks_[i - 1]->unlock();
+                }
+            }
+            static void release(void* arg) { static_cast<LockSet*>(arg)->unlock(); }
+
+        private:
+            std::array<SpinLock*, MAX_SELECT_CASES> locks_{};
+            std::size_t size_{};
+        };
+    } // namespace
+
+    void ChannelBase::close() {
+        std::lock_guard<SpinLock> lock(lock_);
+        closed_.store(true, std::memory_order_release);
+        // they retry and find the channel closed
+        for (auto* queue : {&senders_, &receivers_}) {
+            while (auto* op = queue->claim(nullptr)) {
+                op->state_->waiter_.wake();
+            }
+        }
+    }
+
+    int select(std::span<SelectCase> cases, std::optional<std::chrono::system_clock::duration> timeout) {
+        using detail::SelectState;
+        assertThat(!cases.empty() && cases.size() <= MAX_SELECT_CASES, "select takes 1 to MAX_SELECT_CASES cases");
+        auto nr_cases = cases.size();
+        LockSet locks;
+        for (auto& select_case : cases) {
+            locks.add(&select_case.channel_->lock_);
+        }
+        locks.sort();
+
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        if (timeout) {
+            deadline = std::chrono::steady_clock::now() + *timeout;
+        }
+        // polled from a random case on so that a ready case doesn't starve the ones after it
+        auto start = static_cast<std::size_t>(fastRandom() % nr_cases);
+        auto poll = [&](SelectState const* self) -> std::optional<std::size_t> {
+            for (std::size_t i = 0; i < nr_cases; i++) {
+                auto index = (start + i) % nr_cases;
+                if (cases[index].channel_->pollLocked(cases[index], self)) {
+                    return index;
+                }
+            }
+            return std::nullopt;
+        };
+
+        while (true) {
+            // with a timeout the timer may fire after select returned, it keeps the state alive
+            SelectState local;
+            std::shared_ptr<SelectState> holder;
+            if (deadline && *timeout > std::chrono::system_clock::duration::zero()) {
+                holder = std::make_shared<SelectState>();
+                assertThat(holder->waiter_.fiber_ != nullptr, "select with a timeout must be called in a fiber");
+            }
+            auto* state = holder ? holder.get() : &local;
+
+            locks.lock();
+            if (auto index = poll(state)) {
+                locks.unlock();
+                return static_cast<int>(*index);
+            }
+            auto remaining = deadline ? *deadline - std::chrono::steady_clock::now() : std::chrono::nanoseconds::max();
+            if (remaining <= std::chrono::nanoseconds::zero()) {
+                locks.unlock();
+                return -1;
+            }
+
+            std::array<detail::ChannelOp, MAX_SELECT_CASES> ops;
+            auto queue_of = [&](std::size_t i) -> detail::OpQueue& {
+                return cases[i].send_ ? cases[i].channel_->senders_ : cases[i].channel_->receivers_;
+            };
+            auto remove_ops = [&]() {
+                for (std::size_t i = 0; i < nr_cases; i++) {
+                    queue_of(i).remove(&ops[i]);
+                }
+            };
+            for (std::size_t i = 0; i < nr_cases; i++) {
+                ops[i].state_ = state;
+                ops[i].case_ = &cases[i];
+                ops[i].index_ = static_cast<int>(i);
+                queue_of(i).push(&ops[i]);
+            }
+            // pairs with the fence of ChannelBase::notify: a lock-free push or pop either shows up in this poll or
+            // sees the ops and wakes us up
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (auto index = poll(state)) {
+                remove_ops();
+                locks.unlock();
+                return static_cast<int>(*index);
+            }
+
+            TimerManager::TimerHandle timer;
+            uint64_t timer_owner = 0;
+            if (holder) {
+                // on the processor loop, it can't run before we are switched out
+                timer_owner = Processor::getProcessorID();
+                timer = Processor::getProcessor()->addTimer(remaining, [holder]() {
+                    int none = SelectState::NONE;
+                    if (holder->fired_.compare_exchange_strong(none, SelectState::TIMEOUT, std::memory_order_acq_rel)) {
+                        holder->waiter_.wake();
+                    }
+                });
+            }
+            state->waiter_.wait(&LockSet::release, &locks);
+
+            // the waker holds the lock of its channel until it is done with us
+            locks.lock();
+            remove_ops();
+            locks.unlock();
+            auto fired = state->fired_.load(std::memory_order_acquire);
+            if (fired == SelectState::TIMEOUT) {
+                return -1;
+            }
+            if (holder) {
+                // a case fired first, the timer and the state it holds go now rather than once it expires. Only the
+                // processor it was added on may touch its wheel, we may have been woken up elsewhere
+                if (Processor::getProcessorID() == timer_owner) {
+                    timer.cancel();
+                } else {
+                    IOContext::spawnOn(timer_owner, [timer]() mutable { timer.cancel(); });
+                }
+            }
+            if (ops[static_cast<std::size_t>(fired)].done_) {
+                return fired;
+            }
+            // the channel of the case fired changed, it is polled first
+            start = static_cast<std::size_t>(fired);
+        }
+    }
+
+} // namespace sylar
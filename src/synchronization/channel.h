@@ -0,0 +1,344 @@
+#pragma once
+
+#include "util.h"
+#include "wait_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <utility>
+
+namespace sylar {
+    class ChannelBase;
+    class SelectCase;
+
+    constexpr std::size_t MAX_SELECT_CASES = 16;
+
+    // Wait until one of the cases can run and run it, like Go's select. Returns the index of the case which ran, or
+    // -1 once the timeout expired, a zero timeout only polls. Cases on a closed channel run as well: a send doesn't
+    // send and a receive gets no value, SelectCase::ok tells. At most MAX_SELECT_CASES cases, blocking with a timeout
+    // needs a fiber.
+    int select(std::span<SelectCase> cases,
+               std::optional<std::chrono::system_clock::duration> timeout = std::nullopt);
+
+    // A case of select, made by Channel::sendCase or Channel::recvCase.
+    class SelectCase {
+    public:
+        // once the case ran: the value was sent or received, false if the channel was closed
+        bool ok() const { return ok_; }
+
+    private:
+        friend class ChannelBase;
+        template <class T>
+        friend class Channel;
+        friend int select(std::span<SelectCase>, std::optional<std::chrono::system_clock::duration>);
+
+        SelectCase(ChannelBase* channel, void* value, bool send) : channel_(channel), value_(value), send_(send) {}
+
+        ChannelBase* channel_;
+        // T* to send, std::optional<T>* to receive into
+        void* value_;
+        bool send_;
+        bool ok_{false};
+    };
+
+    namespace detail {
+        // the wait of a select, shared by its cases
+        struct SelectState {
+            static constexpr int NONE = -1;
+            static constexpr int TIMEOUT = -2;
+
+            Waiter waiter_;
+            // the case woken up first, or TIMEOUT
+            std::atomic<int> fired_{NONE};
+        };
+
+        // a case parked in the queue of a channel, it lives on the stack of select
+        struct ChannelOp {
+            ChannelOp* prev_{};
+            ChannelOp* next_{};
+            SelectState* state_{};
+            SelectCase* case_{};
+            int index_{};
+            bool queued_{false};
+            // the waker ran the case, e.g. an unbuffered send handed its value over, otherwise the case is retried
+            bool done_{false};
+        };
+
+        // the parked senders or receivers of a channel, guarded by its lock
+        class OpQueue {
+        public:
+            // read without the lock by the lock-free side of the channel
+            uint32_t size() const { return size_.load(std::memory_order_relaxed); }
+
+            void push(ChannelOp* op) {
+                op->prev_ = tail_;
+                op->next_ = nullptr;
+                if (tail_ == nullptr) {
+                    head_ = op;
+                } else {
+                    tail_->next_ = op;
+                }
+                tail_ = op;
+                op->queued_ = true;
+                size_.fetch_add(1, std::memory_order_seq_cst);
+            }
+
+            void remove(ChannelOp* op) {
+                if (!op->queued_) {
+                    return;
+                }
+                (op->prev_ == nullptr ? head_ : op->prev_->next_) = op->next_;
+                (op->next_ == nullptr ? tail_ : op->next_->prev_) = op->prev_;
+                op->queued_ = false;
+                size_.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            // Dequeue the first op which can fire, the ops of selects woken up by another case are dropped on the
+            // way. The ops of self, the select calling, are skipped.
+            ChannelOp* claim(SelectState const* self) {
+                for (auto* op = head_; op != nullptr;) {
+                    auto* next = op->next_;
+                    if (op->state_ != self) {
+                        remove(op);
+                        int none = SelectState::NONE;
+                        if (op->state_->fired_.compare_exchange_strong(none, op->index_, std::memory_order_acq_rel)) {
+                            return op;
+                        }
+                    }
+                    op = next;
+                }
+                return nullptr;
+            }
+
+        private:
+            ChannelOp* head_{};
+            ChannelOp* tail_{};
+            std::atomic<uint32_t> size_{0};
+        };
+
+        // Bounded MPMC ring after the ones of Dmitry Vyukov and Erik Rigtorp. Each cell has a turn, even while it
+        // waits for the push of a lap of the ring and odd while it waits for the pop, so a push or a pop is a CAS on
+        // its index without any lock. Unlike sequence numbers, turns also work with a single cell.
+        template <class T>
+        class Ring {
+        public:
+            explicit Ring(std::size_t capacity) : capacity_(capacity), cells_(new Cell[capacity]) {}
+
+            // value is left as is if the ring is full
+            bool tryPush(T& value) {
+                auto pos = tail_.load(std::memory_order_relaxed);
+                while (true) {
+                    auto& cell = cells_[pos % capacity_];
+                    auto diff = static_cast<intptr_t>(cell.turn_.load(std::memory_order_acquire)) -
+                                static_cast<intptr_t>(2 * (pos / capacity_));
+                    if (diff == 0) {
+                        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            cell.value_.emplace(std::move(value));
+                            cell.turn_.store(2 * (pos / capacity_) + 1, std::memory_order_release);
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false;
+                    } else {
+                        pos = tail_.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            bool tryPop(std::optional<T>& value) {
+                auto pos = head_.load(std::memory_order_relaxed);
+                while (true) {
+                    auto& cell = cells_[pos % capacity_];
+                    auto diff = static_cast<intptr_t>(cell.turn_.load(std::memory_order_acquire)) -
+                                static_cast<intptr_t>(2 * (pos / capacity_) + 1);
+                    if (diff == 0) {
+                        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            value.emplace(std::move(*cell.value_));
+                            cell.value_.reset();
+                            cell.turn_.store(2 * (pos / capacity_) + 2, std::memory_order_release);
+                            return true;
+                        }
+                    } else if (diff < 0) {
+                        return false;
+                    } else {
+                        pos = head_.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            std::size_t size() const {
+                auto head = head_.load(std::memory_order_relaxed);
+                auto tail = tail_.load(std::memory_order_relaxed);
+                return tail > head ? tail - head : 0;
+            }
+
+        private:
+            struct Cell {
+                std::atomic<std::size_t> turn_{0};
+                std::optional<T> value_;
+            };
+
+            std::size_t capacity_;
+            std::unique_ptr<Cell[]> cells_;
+            alignas(64) std::atomic<std::size_t> head_{0};
+            alignas(64) std::atomic<std::size_t> tail_{0};
+        };
+    } // namespace detail
+
+    // The untyped half of a channel: the parked senders and receivers, close and select.
+    class ChannelBase {
+    public:
+        ChannelBase(ChannelBase const&) = delete;
+        ChannelBase& operator=(ChannelBase const&) = delete;
+
+        // Sends fail from now on, receives drain the buffer and then get no value. The parked fibers are woken up.
+        void close();
+        bool closed() const { return closed_.load(std::memory_order_acquire); }
+        std::size_t capacity() const { return capacity_; }
+
+    protected:
+        friend int select(std::span<SelectCase>, std::optional<std::chrono::system_clock::duration>);
+
+        explicit ChannelBase(std::size_t capacity) : capacity_(capacity) {}
+        virtual ~ChannelBase() = default;
+
+        // run the case if it can without waiting, with lock_ held. self is the select polling, its own ops are
+        // never woken up.
+        virtual bool pollLocked(SelectCase& select_case, detail::SelectState const* self) = 0;
+
+        // with lock_ held, the op woken up retries its case
+        static void wakeOne(detail::OpQueue& queue, detail::SelectState const* self) {
+            if (auto* op = queue.claim(self)) {
+                op->state_->waiter_.wake(true);
+            }
+        }
+        // after a lock-free push or pop, pairs with the fence of select between parking and polling again
+        void notify(detail::OpQueue& queue) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (queue.size() != 0) {
+                lock_.lock();
+                wakeOne(queue, nullptr);
+                lock_.unlock();
+            }
+        }
+
+        std::size_t capacity_;
+        std::atomic<bool> closed_{false};
+        SpinLock lock_;
+        detail::OpQueue senders_;
+        detail::OpQueue receivers_;
+    };
+
+    // A Go-style channel between fibers. Buffered, values go through a lock-free ring and a fiber only parks when it
+    // is full or empty. Unbuffered, a send waits for a receive and hands the value over directly.
+    template <class T>
+    class Channel : public ChannelBase {
+    public:
+        explicit Channel(std::size_t capacity = 0) : ChannelBase(capacity) {
+            if (capacity != 0) {
+                ring_.emplace(capacity);
+            }
+        }
+
+        // false if the channel is closed
+        bool send(T value) {
+            if (ring_ && !closed() && ring_->tryPush(value)) {
+                notify(receivers_);
+                return true;
+            }
+            SelectCase cases[] = {sendCase(value)};
+            select(cases);
+            return cases[0].ok();
+        }
+
+        // no value once the channel is closed and drained
+        std::optional<T> recv() {
+            std::optional<T> value;
+            if (ring_ && ring_->tryPop(value)) {
+                notify(senders_);
+                return value;
+            }
+            SelectCase cases[] = {recvCase(value)};
+            select(cases);
+            return value;
+        }
+
+        // value is left as is unless it was sent
+        bool trySend(T& value) {
+            SelectCase cases[] = {sendCase(value)};
+            return select(cases, std::chrono::system_clock::duration::zero()) == 0 && cases[0].ok();
+        }
+
+        // no value if the channel is empty or closed
+        std::optional<T> tryRecv() {
+            std::optional<T> value;
+            SelectCase cases[] = {recvCase(value)};
+            select(cases, std::chrono::system_clock::duration::zero());
+            return value;
+        }
+
+        // value must live until select returns, it is moved from only if sent
+        SelectCase sendCase(T& value) { return {this, &value, true}; }
+        SelectCase recvCase(std::optional<T>& value) { return {this, &value, false}; }
+
+        // the values buffered, a snapshot
+        std::size_t size() const { return ring_ ? ring_->size() : 0; }
+
+    protected:
+        bool pollLocked(SelectCase& select_case, detail::SelectState const* self) override {
+            auto* value = static_cast<T*>(select_case.value_);
+            auto* dest = static_cast<std::optional<T>*>(select_case.value_);
+            if (select_case.send_) {
+                if (closed()) {
+                    select_case.ok_ = false;
+                    return true;
+                }
+                if (ring_) {
+                    if (!ring_->tryPush(*value)) {
+                        return false;
+                    }
+                    wakeOne(receivers_, self);
+                } else if (auto* op = receivers_.claim(self)) {
+                    handOver(*value, *static_cast<std::optional<T>*>(op->case_->value_), op);
+                } else {
+                    return false;
+                }
+                select_case.ok_ = true;
+                return true;
+            }
+
+            bool received = false;
+            if (ring_) {
+                received = ring_->tryPop(*dest);
+                if (received) {
+                    wakeOne(senders_, self);
+                }
+            } else if (auto* op = senders_.claim(self)) {
+                handOver(*static_cast<T*>(op->case_->value_), *dest, op);
+                received = true;
+            }
+            if (!received && !closed()) {
+                return false;
+            }
+            select_case.ok_ = received;
+            return true;
+        }
+
+    private:
+        // the rendezvous of an unbuffered channel, op is the parked side
+        static void handOver(T& from, std::optional<T>& to, detail::ChannelOp* op) {
+            to.emplace(std::move(from));
+            op->case_->ok_ = true;
+            op->done_ = true;
+            op->state_->waiter_.wake(true);
+        }
+
+        std::optional<detail::Ring<T>> ring_;
+    };
+
+} // namespace sylar
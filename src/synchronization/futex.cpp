@@ -8,7 +8,10 @@ namespace sylar {
     constexpr unsigned int FUTEX_FLAGS = FUTEX2_SIZE_U32 | FUTEX2_PRIVATE;
 
     int futex_wait(std::atomic<uint32_t>* futex, uint32_t val, uint32_t mask) {
-        return UringOp().prep_futex_wait(reinterpret_cast<uint32_t*>(futex), val, mask, FUTEX_FLAGS, 0).await();
+        return UringOp()
+            .prep_futex_wait(reinterpret_cast<uint32_t*>(futex), val, mask, FUTEX_FLAGS, 0)
+            .handoff()
+            .await();
     }
 
     int futex_notify(std::atomic<uint32_t>* futex, std::size_t count, uint32_t mask) {
@@ -0,0 +1,94 @@
+#include "mutex.h"
+
+#include "processor.h"
+
+#include <mutex>
+#include <optional>
+
+namespace sylar {
+    void Mutex::lockSlow() {
+        auto* fiber = Fiber::getCurrentFiber();
+        bool in_fiber = fiber != nullptr && fiber != Processor::getProcessorFiber();
+        std::optional<std::chrono::steady_clock::time_point> wait_start;
+        bool starving = false;
+        unsigned spins = 0;
+        auto state = state_.load(std::memory_order_relaxed);
+        while (true) {
+            // barge in, unless the mutex is being handed over to the waiters
+            if ((state & (LOCKED | STARVING)) == 0) {
+                if (state_.compare_exchange_weak(state, state | LOCKED, std::memory_order_acquire,
+                                                 std::memory_order_relaxed)) {
+                    return;
+                }
+                continue;
+            }
+            if ((state & STARVING) == 0 && spins < DEFAULT_SPIN_COUNT) {
+                spins++;
+                if (in_fiber) {
+                    Fiber::yield(Fiber::READY);
+                } else {
+                    cpuRelax();
+                }
+                state = state_.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            // announce the waiter to unlock, unless the mutex was released meanwhile
+            Waiter waiter;
+            wait_lock_.lock();
+            state = state_.load(std::memory_order_relaxed);
+            bool queued = false;
+            while ((state & (LOCKED | STARVING)) != 0) {
+                auto desired = state | WAITERS | (starving && (state & LOCKED) != 0 ? STARVING : 0);
+                if (state_.compare_exchange_weak(state, desired, std::memory_order_relaxed,
+                                                 std::memory_order_relaxed)) {
+                    queued = true;
+                    break;
+                }
+            }
+            if (!queued) {
+                wait_lock_.unlock();
+                continue;
+            }
+            if (wait_start) {
+                waiters_.pushFront(&waiter);
+            } else {
+                waiters_.pushBack(&waiter);
+                wait_start = std::chrono::steady_clock::now();
+            }
+            waiter.wait(wait_lock_);
+
+            starving = starving || std::chrono::steady_clock::now() - *wait_start > STARVATION_THRESHOLD;
+            if (waiter.handoff_) {
+                // The mutex is ours: unlock left LOCKED clear and nobody else takes it while STARVING is set. Back to
+                // the normal mode if we are the last waiter or didn't wait long, flipping both bits at once.
+                auto flip = LOCKED;
+                if (!starving || (state_.load(std::memory_order_relaxed) & WAITERS) == 0) {
+                    flip |= STARVING;
+                }
+                state_.fetch_xor(flip, std::memory_order_acquire);
+                return;
+            }
+            spins = 0;
+            state = state_.load(std::memory_order_relaxed);
+        }
+    }
+
+    void Mutex::unlockSlow(uint32_t state) {
+        std::lock_guard<SpinLock> lock(wait_lock_);
+        auto* waiter = waiters_.pop();
+        if (waiters_.empty()) {
+            state_.fetch_and(~WAITERS, std::memory_order_relaxed);
+        }
+        if (waiter == nullptr) {
+            // nobody to hand the mutex over to, it must not stay out of reach of the newcomers
+            state_.fetch_and(~STARVING, std::memory_order_relaxed);
+            return;
+        }
+        waiter->handoff_ = (state & STARVING) != 0;
+        // the new owner must not wait out of sight of the thieves until the unlocker yields, its run next slot is
+        // only for a waiter which still has to compete
+        waiter->wake(!waiter->handoff_);
+    }
+
+} // namespace sylar
@@ -2,61 +2,61 @@
 
 #include "detail/fiber.h"
 #include "futex.h"
+#include "wait_queue.h"
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <spdlog/spdlog.h>
 
 namespace sylar {
+    // Fibers block in a wait queue of the mutex rather than on a kernel futex, a contended lock or unlock never
+    // leaves user space unless a thread off the runtime waits. Like Go's sync.Mutex there are two modes:
+    // - normal: unlock wakes the first waiter, it runs next on the processor of the unlocker and competes with
+    //   the newcomers, which usually win since they are already running;
+    // - starving: entered once a waiter waited longer than STARVATION_THRESHOLD, unlock hands the mutex over to the
+    //   first waiter and newcomers queue up behind it. The owner goes into the run queue, where an idle processor
+    //   can steal it. Left when the queue empties or a waiter got the mutex quickly.
     struct Mutex {
     public:
         bool try_lock() {
-            auto expected = UNLOCKED;
-            return futex_.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire,
+            auto state = state_.load(std::memory_order_relaxed);
+            return (state & (LOCKED | STARVING)) == 0 &&
+                   state_.compare_exchange_strong(state, state | LOCKED, std::memory_order_acquire,
                                                   std::memory_order_relaxed);
         }
 
         void lock() {
-            auto state = spin();
-            // Before go into contention state, try to grab the lock.
-            if (state == UNLOCKED &&
-                futex_.compare_exchange_strong(state, LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) {
-                return;
-            }
-            while (true) {
-                if (state != IN_CONTENTION && futex_.exchange(IN_CONTENTION, std::memory_order_acquire) == UNLOCKED) {
-                    return;
-                }
-                futex_.wait(IN_CONTENTION);
-                state = spin();
+            auto expected = UNLOCKED;
+            if (!state_.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire,
+                                                std::memory_order_relaxed)) [[unlikely]] {
+                lockSlow();
             }
         }
 
         void unlock() {
-            auto prev = futex_.exchange(UNLOCKED, std::memory_order_release);
-            if (prev == IN_CONTENTION) {
-                futex_.notify_one();
+            auto state = state_.fetch_sub(LOCKED, std::memory_order_release) - LOCKED;
+            if (state != UNLOCKED) [[unlikely]] {
+                unlockSlow(state);
             }
         }
 
     private:
-        uint32_t spin(unsigned count = DEFAULT_SPIN_COUNT) {
-            while (true) {
-                auto result = futex_.load(std::memory_order_relaxed);
-                if (result == UNLOCKED || count == 0) {
-                    return result;
-                }
-                Fiber::yield(Fiber::READY);
-                count--;
-            }
-        }
-        static constexpr uint32_t UNLOCKED = 0b00;
-        static constexpr uint32_t LOCKED = 0b01;
-        static constexpr uint32_t IN_CONTENTION = 0b10;
+        void lockSlow();
+        void unlockSlow(uint32_t state);
 
-        static constexpr unsigned int DEFAULT_SPIN_COUNT = 100;
+        static constexpr uint32_t UNLOCKED = 0b000;
+        static constexpr uint32_t LOCKED = 0b001;
+        static constexpr uint32_t WAITERS = 0b010;
+        static constexpr uint32_t STARVING = 0b100;
 
-        Futex futex_;
+        // yields before going into the wait queue
+        static constexpr unsigned int DEFAULT_SPIN_COUNT = 4;
+        static constexpr std::chrono::microseconds STARVATION_THRESHOLD{1000};
+
+        std::atomic<uint32_t> state_{UNLOCKED};
+        SpinLock wait_lock_;
+        WaitQueue waiters_;
     };
 
     struct ConditionVariable {
@@ -0,0 +1,69 @@
+#include "shared_mutex.h"
+
+#include <mutex>
+
+namespace sylar {
+    void SharedMutex::lock() {
+        writer_mutex_.lock();
+        // from now on the readers queue up
+        if (state_.fetch_add(WRITER, std::memory_order_acquire) == 0) {
+            return;
+        }
+        Waiter waiter;
+        wait_lock_.lock();
+        if ((state_.load(std::memory_order_acquire) & ~WRITER) == 0) {
+            wait_lock_.unlock();
+            return;
+        }
+        writer_ = &waiter;
+        waiter.wait(wait_lock_);
+    }
+
+    bool SharedMutex::try_lock() {
+        if (!writer_mutex_.try_lock()) {
+            return false;
+        }
+        uint32_t expected = 0;
+        if (state_.compare_exchange_strong(expected, WRITER, std::memory_order_acquire, std::memory_order_relaxed)) {
+            return true;
+        }
+        writer_mutex_.unlock();
+        return false;
+    }
+
+    void SharedMutex::unlock() {
+        {
+            // the queued readers get the lock in one go, counted in before they run
+            std::lock_guard<SpinLock> lock(wait_lock_);
+            state_.fetch_sub(WRITER - static_cast<uint32_t>(readers_.size()), std::memory_order_release);
+            readers_.wakeAll();
+        }
+        writer_mutex_.unlock();
+    }
+
+    void SharedMutex::lockSharedSlow() {
+        while (true) {
+            Waiter waiter;
+            wait_lock_.lock();
+            if ((state_.load(std::memory_order_relaxed) & WRITER) != 0) {
+                readers_.pushBack(&waiter);
+                // counted in by unlock
+                waiter.wait(wait_lock_);
+                return;
+            }
+            wait_lock_.unlock();
+            if (try_lock_shared()) {
+                return;
+            }
+        }
+    }
+
+    void SharedMutex::wakeWriter() {
+        std::lock_guard<SpinLock> lock(wait_lock_);
+        // a reader which left before the writer checked may come late, after a new writer queued up
+        if (writer_ != nullptr && (state_.load(std::memory_order_acquire) & ~WRITER) == 0) {
+            std::exchange(writer_, nullptr)->wake(true);
+        }
+    }
+
+} // namespace sylar
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "mutex.h"
+#include "wait_queue.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace sylar {
+    // Reader-writer lock for read-mostly data, e.g. routing tables or config snapshots. Readers only touch a counter
+    // while no writer is around. It prefers writers: once a writer is waiting, new readers queue up behind it and the
+    // writer waits for the readers inside to drain. Its unlock hands the lock over to all the queued readers at once,
+    // before the next writer gets in.
+    class SharedMutex {
+    public:
+        void lock();
+        bool try_lock();
+        void unlock();
+
+        void lock_shared() {
+            auto state = state_.load(std::memory_order_relaxed);
+            while ((state & WRITER) == 0) {
+                if (state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire,
+                                                 std::memory_order_relaxed)) {
+                    return;
+                }
+            }
+            lockSharedSlow();
+        }
+
+        bool try_lock_shared() {
+            auto state = state_.load(std::memory_order_relaxed);
+            while ((state & WRITER) == 0) {
+                if (state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire,
+                                                 std::memory_order_relaxed)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void unlock_shared() {
+            // the last reader out lets the waiting writer in
+            if (state_.fetch_sub(1, std::memory_order_release) == (WRITER | 1)) [[unlikely]] {
+                wakeWriter();
+            }
+        }
+
+    private:
+        void lockSharedSlow();
+        void wakeWriter();
+
+        // set while a writer holds the lock or waits for the readers to drain, the low bits count the readers
+        static constexpr uint32_t WRITER = uint32_t{1} << 31;
+
+        std::atomic<uint32_t> state_{0};
+        // one writer at a time
+        Mutex writer_mutex_;
+        SpinLock wait_lock_;
+        WaitQueue readers_;
+        // the writer waiting for the readers to drain
+        Waiter* writer_{};
+    };
+
+} // namespace sylar
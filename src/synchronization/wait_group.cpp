@@ -0,0 +1,73 @@
+#include "wait_group.h"
+
+namespace sylar {
+    namespace detail {
+        void Countdown::wait() {
+            while (true) {
+                auto state = state_.load(std::memory_order_acquire);
+                if (count(state) == 0) {
+                    if (waiters(state) == 0) {
+                        return;
+                    }
+                    // the waker of the previous drop to zero still uses the object, it lets the waiters go soon
+                    cpuRelax();
+                    continue;
+                }
+
+                Waiter waiter;
+                wait_lock_.lock();
+                // counted and queued under the lock, wakeAll takes exactly the waiters counted
+                while (count(state) != 0 &&
+                       !state_.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel,
+                                                     std::memory_order_acquire)) {
+                }
+                if (count(state) == 0) {
+                    wait_lock_.unlock();
+                    continue;
+                }
+                waiters_.pushBack(&waiter);
+                waiter.wait(wait_lock_);
+                return;
+            }
+        }
+
+        void Countdown::wakeAll() {
+            wait_lock_.lock();
+            auto nr_waiters = waiters_.size();
+            auto* waiters = waiters_.popAll();
+            wait_lock_.unlock();
+            // the last use of the object, the waiters which didn't queue may return from now on
+            state_.fetch_sub(nr_waiters, std::memory_order_release);
+            WaitQueue::wakeList(waiters);
+        }
+    } // namespace detail
+
+    void Barrier::arrive(bool drop) {
+        wait_lock_.lock();
+        if (drop) {
+            expected_--;
+        }
+        if (--pending_ > 0) {
+            if (drop) {
+                wait_lock_.unlock();
+                return;
+            }
+            Waiter waiter;
+            waiters_.pushBack(&waiter);
+            waiter.wait(wait_lock_);
+            return;
+        }
+        // everyone else is waiting, nobody touches the barrier while completion runs out of the spin lock
+        wait_lock_.unlock();
+        if (completion_) {
+            completion_();
+        }
+        wait_lock_.lock();
+        pending_ = expected_;
+        auto* waiters = waiters_.popAll();
+        wait_lock_.unlock();
+        // a woken fiber may leave the barrier and take it with it
+        WaitQueue::wakeList(waiters);
+    }
+
+} // namespace sylar
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "wait_queue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+namespace sylar {
+    namespace detail {
+        // A counter and the number of fibers waiting for it to drop to zero, in one word: the upper half counts, the
+        // lower half the waiters. The drop only takes the lock when somebody waits, and the waiters are only let go
+        // once the object isn't used anymore, a wait returning may take it with it.
+        class Countdown {
+        public:
+            explicit Countdown(int32_t count) : state_(uint64_t{static_cast<uint32_t>(count)} << COUNT_SHIFT) {}
+
+            // add delta to the counter and wake the waiters if it dropped to zero, return the counter
+            int32_t add(int64_t delta) {
+                auto update = static_cast<uint64_t>(delta) << COUNT_SHIFT;
+                auto state = state_.fetch_add(update, std::memory_order_acq_rel) + update;
+                if (count(state) == 0 && waiters(state) != 0) {
+                    wakeAll();
+                }
+                return count(state);
+            }
+            // zero, and no wake is in progress
+            bool done() const noexcept { return state_.load(std::memory_order_acquire) == 0; }
+            void wait();
+
+        private:
+            static constexpr unsigned COUNT_SHIFT = 32;
+            static int32_t count(uint64_t state) noexcept { return static_cast<int32_t>(state >> COUNT_SHIFT); }
+            static uint32_t waiters(uint64_t state) noexcept { return static_cast<uint32_t>(state); }
+
+            void wakeAll();
+
+            std::atomic<uint64_t> state_;
+            SpinLock wait_lock_;
+            WaitQueue waiters_;
+        };
+    } // namespace detail
+
+    // Waits for a group of fibers to finish, like Go's sync.WaitGroup: add before spawning, done when finished. It may
+    // be reused once wait returned. A thread off the runtime can wait as well, e.g. main waiting for its fibers.
+    class WaitGroup {
+    public:
+        void add(int64_t count = 1) { assertThat(counter_.add(count) >= 0, "WaitGroup counter is negative"); }
+        void done() { add(-1); }
+
+        void wait() { counter_.wait(); }
+
+    private:
+        detail::Countdown counter_{0};
+    };
+
+    // A single-use countdown, std::latch for fibers: waiting doesn't block the processor thread.
+    class Latch {
+    public:
+        // expected fits in 32 bits
+        explicit Latch(std::ptrdiff_t expected) : counter_(static_cast<int32_t>(expected)) {}
+
+        void count_down(std::ptrdiff_t update = 1) {
+            assertThat(counter_.add(-update) >= 0, "Latch counted down below zero");
+        }
+        // false while the waiters of the drop to zero are still being woken up
+        bool try_wait() const noexcept { return counter_.done(); }
+        void wait() { counter_.wait(); }
+        void arrive_and_wait(std::ptrdiff_t update = 1) {
+            count_down(update);
+            wait();
+        }
+
+    private:
+        detail::Countdown counter_;
+    };
+
+    // A reusable rendezvous of expected fibers, std::barrier for fibers. The last one to arrive runs completion, if
+    // any, before the others are released into the next phase.
+    class Barrier {
+    public:
+        using Func = std::function<void()>;
+
+        explicit Barrier(std::ptrdiff_t expected, Func completion = nullptr)
+            : expected_(expected), pending_(expected), completion_(std::move(completion)) {}
+
+        void arrive_and_wait() { arrive(false); }
+        // arrive and leave the barrier, the next phases expect one less
+        void arrive_and_drop() { arrive(true); }
+
+    private:
+        // a dropping fiber doesn't wait for the phase to complete
+        void arrive(bool drop);
+
+        std::ptrdiff_t expected_;
+        std::ptrdiff_t pending_;
+        Func completion_;
+        SpinLock wait_lock_;
+        WaitQueue waiters_;
+    };
+
+} // namespace sylar
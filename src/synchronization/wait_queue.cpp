@@ -0,0 +1,42 @@
+#include "wait_queue.h"
+
+#include "processor.h"
+
+namespace sylar {
+    Waiter::Waiter() {
+        auto* fiber = Fiber::getCurrentFiber();
+        fiber_ = Processor::getProcessor() != nullptr && fiber != Processor::getProcessorFiber() ? fiber : nullptr;
+    }
+
+    void Waiter::wait(SpinLock& lock) {
+        wait([](void* arg) { static_cast<SpinLock*>(arg)->unlock(); }, &lock);
+    }
+
+    void Waiter::wait(void (*release)(void*), void* arg) {
+        if (fiber_ != nullptr) {
+            Processor::suspend(release, arg);
+            return;
+        }
+        release(arg);
+        // our stack must outlive the notify of the waker, WAKING is only held for it
+        for (auto woken = woken_.load(std::memory_order_acquire); woken != WOKEN;
+             woken = woken_.load(std::memory_order_acquire)) {
+            if (woken == 0) {
+                woken_.wait(0, std::memory_order_acquire);
+            } else {
+                cpuRelax();
+            }
+        }
+    }
+
+    void Waiter::wake(bool next) {
+        if (fiber_ != nullptr) {
+            Processor::ready(fiber_, next);
+            return;
+        }
+        woken_.store(WAKING, std::memory_order_release);
+        woken_.notify_one();
+        woken_.store(WOKEN, std::memory_order_release);
+    }
+
+} // namespace sylar
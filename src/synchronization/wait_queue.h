@@ -0,0 +1,119 @@
+#pragma once
+
+#include "detail/fiber.h"
+#include "util.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace sylar {
+    // Guards the short critical sections of the wait queues, nobody ever blocks while holding it.
+    class SpinLock {
+    public:
+        void lock() {
+            while (locked_.exchange(true, std::memory_order_acquire)) {
+                while (locked_.load(std::memory_order_relaxed)) {
+                    cpuRelax();
+                }
+            }
+        }
+        void unlock() { locked_.store(false, std::memory_order_release); }
+
+    private:
+        std::atomic<bool> locked_{false};
+    };
+
+    // A fiber or a thread blocked in a synchronization primitive, it lives on the stack of the waiter.
+    struct Waiter {
+        Waiter();
+
+        // Block until woken up, lock is the one guarding the queue the waiter went into and is released once the
+        // waiter can be woken up. A fiber is switched out, a thread off the runtime falls back to a kernel futex.
+        void wait(SpinLock& lock);
+        // Same with several locks, release(arg) is called once the waiter can be woken up.
+        void wait(void (*release)(void*), void* arg);
+        // Called with the lock held, or after the waiter was taken out of the queue under it. The waiter may be gone
+        // once it returns. With next a fiber runs right after the waker yields, see Processor::ready.
+        void wake(bool next = false);
+
+        Waiter* next_{};
+        // nullptr for a thread, including a processor outside of its fibers
+        Fiber* fiber_;
+        // set by the waker, e.g. when a mutex is handed over
+        bool handoff_{false};
+        // the futex of a thread waiter, WAKING while the waker still uses it
+        std::atomic<uint32_t> woken_{0};
+        static constexpr uint32_t WAKING = 1;
+        static constexpr uint32_t WOKEN = 2;
+    };
+
+    // intrusive FIFO of waiters, guarded by a SpinLock of its owner
+    class WaitQueue {
+    public:
+        bool empty() const { return head_ == nullptr; }
+        std::size_t size() const { return size_; }
+
+        void pushBack(Waiter* waiter) {
+            waiter->next_ = nullptr;
+            if (tail_ == nullptr) {
+                head_ = waiter;
+            } else {
+                tail_->next_ = waiter;
+            }
+            tail_ = waiter;
+            size_++;
+        }
+
+        // a waiter which already waited goes back to the front, it keeps its turn
+        void pushFront(Waiter* waiter) {
+            waiter->next_ = head_;
+            head_ = waiter;
+            if (tail_ == nullptr) {
+                tail_ = waiter;
+            }
+            size_++;
+        }
+
+        Waiter* pop() {
+            auto* waiter = head_;
+            if (waiter != nullptr) {
+                head_ = waiter->next_;
+                if (head_ == nullptr) {
+                    tail_ = nullptr;
+                }
+                size_--;
+            }
+            return waiter;
+        }
+
+        // wake every waiter, called with the lock held
+        void wakeAll() {
+            while (auto* waiter = pop()) {
+                waiter->wake();
+            }
+        }
+
+        // take every waiter out, to wake them up by wakeList once the lock is released
+        Waiter* popAll() {
+            tail_ = nullptr;
+            size_ = 0;
+            return std::exchange(head_, nullptr);
+        }
+        // wake the waiters taken by popAll, without the lock: a woken waiter may take the owner of the queue with it
+        static void wakeList(Waiter* waiter) {
+            while (waiter != nullptr) {
+                auto* next = waiter->next_;
+                waiter->wake();
+                waiter = next;
+            }
+        }
+
+    private:
+        Waiter* head_{};
+        Waiter* tail_{};
+        std::size_t size_{};
+    };
+
+} // namespace sylar
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <variant>
+
+#include <spdlog/spdlog.h>
+
+namespace sylar {
+    // Stackless coroutine running on the processor fiber, side by side with the fibers of the processor.
+    // A Task is lazy, it starts when awaited or spawned by IOContext::spawn, and `co_await UringOp().prep_xxx()`
+    // suspends it until the completion is drained by Processor::waitEvent.
+    // Fiber blocking APIs (UringOp::await, Mutex, sleepFor...) must not be called from a Task.
+    template <class T = void>
+    class [[nodiscard]] Task;
+
+    namespace detail {
+        struct TaskPromiseBase {
+            struct FinalAwaiter {
+                bool await_ready() const noexcept { return false; }
+                template <class Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept {
+                    auto continuation = handle.promise().continuation_;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+                void await_resume() const noexcept {}
+            };
+
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+            FinalAwaiter final_suspend() const noexcept { return {}; }
+
+            std::coroutine_handle<> continuation_;
+        };
+
+        template <class T>
+        struct TaskPromise : TaskPromiseBase {
+            Task<T> get_return_object() noexcept;
+
+            template <class U>
+            void return_value(U&& value) {
+                result_.template emplace<1>(std::forward<U>(value));
+            }
+            void unhandled_exception() noexcept { result_.template emplace<2>(std::current_exception()); }
+
+            T result() {
+                if (result_.index() == 2) {
+                    std::rethrow_exception(std::get<2>(result_));
+                }
+                return std::move(std::get<1>(result_));
+            }
+
+            std::variant<std::monostate, T, std::exception_ptr> result_;
+        };
+
+        template <>
+        struct TaskPromise<void> : TaskPromiseBase {
+            Task<void> get_return_object() noexcept;
+
+            void return_void() const noexcept {}
+            void unhandled_exception() noexcept { exception_ = std::current_exception(); }
+
+            void result() const {
+                if (exception_) {
+                    std::rethrow_exception(exception_);
+                }
+            }
+
+            std::exception_ptr exception_;
+        };
+    } // namespace detail
+
+    template <class T>
+    class [[nodiscard]] Task {
+    public:
+        using promise_type = detail::TaskPromise<T>;
+        using handle_type = std::coroutine_handle<promise_type>;
+
+        Task() noexcept = default;
+        explicit Task(handle_type handle) noexcept : handle_(handle) {}
+
+        Task(Task&& that) noexcept : handle_(std::exchange(that.handle_, {})) {}
+        Task& operator=(Task&& that) noexcept {
+            std::swap(handle_, that.handle_);
+            return *this;
+        }
+
+        ~Task() {
+            if (handle_) {
+                handle_.destroy();
+            }
+        }
+
+        auto operator co_await() && noexcept {
+            struct Awaiter {
+                bool await_ready() const noexcept { return !handle_ || handle_.done(); }
+                // start the task and come back when it finishes
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) const noexcept {
+                    handle_.promise().continuation_ = continuation;
+                    return handle_;
+                }
+                T await_resume() const { return handle_.promise().result(); }
+
+                handle_type handle_;
+            };
+            return Awaiter{handle_};
+        }
+
+    private:
+        handle_type handle_;
+    };
+
+    namespace detail {
+        template <class T>
+        Task<T> TaskPromise<T>::get_return_object() noexcept {
+            return Task<T>{std::coroutine_handle<TaskPromise<T>>::from_promise(*this)};
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+            return Task<void>{std::coroutine_handle<TaskPromise<void>>::from_promise(*this)};
+        }
+
+        // owns a spawned task and destroys itself once the task is done
+        struct DetachedTask {
+            struct promise_type {
+                DetachedTask get_return_object() noexcept {
+                    return {std::coroutine_handle<promise_type>::from_promise(*this)};
+                }
+                std::suspend_always initial_suspend() const noexcept { return {}; }
+                std::suspend_never final_suspend() const noexcept { return {}; }
+                void return_void() const noexcept {}
+                void unhandled_exception() const noexcept {}
+            };
+
+            std::coroutine_handle<> handle_;
+        };
+
+        inline DetachedTask detach(Task<void> task) {
+            try {
+                co_await std::move(task);
+            } catch (std::exception& ex) {
+                spdlog::error("Task error: {}", ex.what());
+            } catch (...) {
+                spdlog::error("Task error");
+            }
+        }
+    } // namespace detail
+
+} // namespace sylar
@@ -0,0 +1,196 @@
+#include "tracer.h"
+#include "processor.h"
+
+#include <bit>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace sylar {
+    namespace {
+        uint64_t readTsc() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+        }
+
+        struct Record {
+            uint64_t tsc_;
+            uint64_t id_;
+            int64_t arg_;
+            TraceEvent event_;
+        };
+
+        // written by its thread only, the dumper copies it and drops what was overwritten in the meantime
+        struct Buffer {
+            explicit Buffer(std::size_t capacity, uint64_t tid, bool processor)
+                : records_(std::make_unique<Record[]>(capacity)), mask_(capacity - 1), tid_(tid),
+                  processor_(processor) {}
+
+            std::unique_ptr<Record[]> records_;
+            std::size_t mask_;
+            std::atomic<uint64_t> head_{0};
+            uint64_t tid_;
+            bool processor_;
+        };
+
+        struct Registry {
+            std::mutex mutex_;
+            // never freed, a dump may read the buffer of an exited thread
+            std::vector<std::unique_ptr<Buffer>> buffers_;
+            std::size_t capacity_{};
+            // TSC and steady clock when enabled, to convert ticks to microseconds
+            uint64_t base_tsc_{};
+            std::chrono::steady_clock::time_point base_time_;
+        };
+
+        Registry& registry() {
+            static Registry registry;
+            return registry;
+        }
+
+        thread_local Buffer* t_buffer{};
+
+        Buffer* registerThread() {
+            auto& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex_);
+            auto* processor = Processor::getProcessor();
+            auto tid = processor ? Processor::getProcessorID() : static_cast<uint64_t>(gettid());
+            reg.buffers_.push_back(std::make_unique<Buffer>(reg.capacity_, tid, processor != nullptr));
+            return reg.buffers_.back().get();
+        }
+
+        const char* eventName(TraceEvent event) {
+            switch (event) {
+            case TraceEvent::FiberCreate:
+                return "create";
+            case TraceEvent::FiberResume:
+                return "resume";
+            case TraceEvent::FiberYield:
+                return "yield";
+            case TraceEvent::FiberSteal:
+                return "steal";
+            case TraceEvent::FiberTerm:
+                return "terminate";
+            case TraceEvent::Submit:
+                return "submit";
+            case TraceEvent::Complete:
+                return "complete";
+            case TraceEvent::TimerFire:
+                return "timers";
+            }
+            return "unknown";
+        }
+    } // namespace
+
+    void Tracer::enable(std::size_t events_per_thread) {
+        auto& reg = registry();
+        {
+            std::lock_guard<std::mutex> lock(reg.mutex_);
+            if (reg.capacity_ == 0) {
+                reg.capacity_ = std::bit_ceil(std::max<std::size_t>(events_per_thread, 2));
+                reg.base_tsc_ = readTsc();
+                reg.base_time_ = std::chrono::steady_clock::now();
+            }
+        }
+        enabled_.store(true, std::memory_order_relaxed);
+    }
+
+    void Tracer::disable() { enabled_.store(false, std::memory_order_relaxed); }
+
+    void Tracer::record(TraceEvent event, uint64_t id, int64_t arg) noexcept {
+        auto* buffer = t_buffer;
+        if (buffer == nullptr) [[unlikely]] {
+            try {
+                buffer = t_buffer = registerThread();
+            } catch (...) {
+                return;
+            }
+        }
+        auto head = buffer->head_.load(std::memory_order_relaxed);
+        buffer->records_[head & buffer->mask_] = {readTsc(), id, arg, event};
+        buffer->head_.store(head + 1, std::memory_order_release);
+    }
+
+    std::string Tracer::dumpChromeTrace() {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex_);
+        std::string out = "{\"traceEvents\":[\n";
+        if (reg.capacity_ == 0) {
+            return out + "]}\n";
+        }
+
+        auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - reg.base_time_);
+        auto now_tsc = readTsc();
+        double ticks_per_us = elapsed.count() > 0 ? static_cast<double>(now_tsc - reg.base_tsc_) / elapsed.count() : 1;
+        auto toUs = [&](uint64_t tsc) {
+            return tsc >= reg.base_tsc_ ? static_cast<double>(tsc - reg.base_tsc_) / ticks_per_us : 0.0;
+        };
+
+        bool first = true;
+        auto append = [&](std::string const& event) {
+            out += first ? "" : ",\n";
+            out += event;
+            first = false;
+        };
+
+        std::vector<Record> records;
+        for (auto const& buffer : reg.buffers_) {
+            auto tid = buffer->processor_ ? buffer->tid_ : buffer->tid_ + 1'000'000;
+            append(fmt::format(R"({{"ph":"M","name":"thread_name","pid":1,"tid":{},"args":{{"name":"{} {}"}}}})", tid,
+                               buffer->processor_ ? "processor" : "thread", buffer->tid_));
+
+            auto capacity = buffer->mask_ + 1;
+            auto head = buffer->head_.load(std::memory_order_acquire);
+            auto begin = head > capacity ? head - capacity : 0;
+            records.clear();
+            for (auto i = begin; i < head; i++) {
+                records.push_back(buffer->records_[i & buffer->mask_]);
+            }
+            // the writer may have overwritten the oldest records while we copied them
+            auto after = buffer->head_.load(std::memory_order_acquire);
+            auto skip = after > capacity + begin ? std::min<uint64_t>(after - capacity - begin, records.size()) : 0;
+
+            // a fiber run is the slice from its resume to its yield or termination
+            std::unordered_map<uint64_t, uint64_t> running;
+            for (auto it = records.begin() + static_cast<std::ptrdiff_t>(skip); it != records.end(); ++it) {
+                auto const& record = *it;
+                switch (record.event_) {
+                case TraceEvent::FiberResume:
+                    running[record.id_] = record.tsc_;
+                    break;
+                case TraceEvent::FiberYield:
+                case TraceEvent::FiberTerm:
+                    if (auto run = running.find(record.id_); run != running.end()) {
+                        append(fmt::format(
+                            R"({{"ph":"X","name":"fiber {:#x}","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f},)"
+                            R"("args":{{"end":"{}","state":{}}}}})",
+                            record.id_, tid, toUs(run->second), toUs(record.tsc_) - toUs(run->second),
+                            eventName(record.event_), record.arg_));
+                        running.erase(run);
+                    }
+                    break;
+                default:
+                    append(fmt::format(
+                        R"({{"ph":"i","s":"t","name":"{}","pid":1,"tid":{},"ts":{:.3f},"args":{{"id":"{:#x}","arg":{}}}}})",
+                        eventName(record.event_), tid, toUs(record.tsc_), record.id_, record.arg_));
+                    break;
+                }
+            }
+        }
+        out += "\n]}\n";
+        return out;
+    }
+
+} // namespace sylar
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace sylar {
+    enum class TraceEvent : uint8_t {
+        FiberCreate,
+        FiberResume,
+        // arg is the state the fiber yields with
+        FiberYield,
+        // id is the victim processor, arg the number of stolen tasks
+        FiberSteal,
+        FiberTerm,
+        // arg is the number of SQEs submitted
+        Submit,
+        // id is the fiber resumed, arg the result of the op
+        Complete,
+        // arg is the number of expired timers
+        TimerFire,
+    };
+
+    // Opt-in scheduling tracer. Each thread records into a ring buffer of its own, single writer and overwriting the
+    // oldest events, timestamps are TSC ticks. Disabled, a trace point costs a relaxed load and a branch.
+    class Tracer {
+    public:
+        // start recording, buffers hold events_per_thread events (rounded up to a power of 2), a thread keeps the
+        // size of its buffer once created
+        static void enable(std::size_t events_per_thread = 1 << 16);
+        static void disable();
+        static bool isEnabled() noexcept { return enabled_.load(std::memory_order_relaxed); }
+
+        static void record(TraceEvent event, uint64_t id, int64_t arg) noexcept;
+
+        // Chrome trace event JSON of the events in the buffers, Perfetto UI opens it as well. Fiber runs are slices
+        // on the track of their processor, the other events are instants. Events recorded during the dump may be
+        // missing, disable the tracer first for a consistent dump.
+        static std::string dumpChromeTrace();
+
+    private:
+        static inline std::atomic<bool> enabled_{false};
+    };
+
+    inline void trace(TraceEvent event, uint64_t id, int64_t arg = 0) noexcept {
+        if (Tracer::isEnabled()) [[unlikely]] {
+            Tracer::record(event, id, arg);
+        }
+    }
+
+    template <class T>
+    void trace(TraceEvent event, T* ptr, int64_t arg = 0) noexcept {
+        trace(event, reinterpret_cast<uint64_t>(ptr), arg);
+    }
+
+} // namespace sylar
@@ -4,11 +4,21 @@
 #include "processor.h"
 #include "util.h"
 
+#include <coroutine>
 #include <liburing.h>
 #include <optional>
 #include <spdlog/spdlog.h>
 
 namespace sylar {
+    // Receives the CQEs of a multishot op submitted with Processor::getSqe(handler), the last one comes without
+    // IORING_CQE_F_MORE. Called by Processor::waitEvent on the processor thread, it must not block.
+    struct UringHandler {
+        virtual void complete(struct io_uring_cqe const* cqe) = 0;
+
+    protected:
+        ~UringHandler() = default;
+    };
+
     // NOLINTBEGIN
     struct [[nodiscard]] UringOp {
         using timeout_type = std::optional<std::chrono::system_clock::duration>;
@@ -28,6 +38,10 @@ namespace sylar {
         struct UringData {
             int res_{};
             Fiber* fiber_{Fiber::getCurrentFiber()};
+            // set when awaited by a Task instead of a fiber
+            std::coroutine_handle<> coroutine_{};
+            // the fiber goes into the run next slot on completion, see handoff
+            bool handoff_{false};
         };
 
         struct io_uring_sqe* getSqe() { return Processor::getProcessor()->getSqe(); }
@@ -79,6 +93,55 @@ namespace sylar {
             return op_data_.res_;
         }
 
+        // co_await UringOp().prep_xxx() from a Task, the temporary UringOp lives in the coroutine frame until resumed
+        auto operator co_await() && {
+            struct Awaiter {
+                bool await_ready() const noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> coroutine) const {
+                    assertThat(!op_.timeout_, "timeout is only supported by fibers");
+                    op_.op_data_.fiber_ = nullptr;
+                    op_.op_data_.coroutine_ = coroutine;
+                }
+                int await_resume() const noexcept {
+                    op_.yield_ = true;
+                    return op_.op_data_.res_;
+                }
+
+                UringOp& op_;
+            };
+            return Awaiter{*this};
+        }
+
+        // the fd passed to prep_xxx is an index into the registered file table of the processor
+        [[nodiscard("need to call await")]]
+        UringOp&& fixed_file(bool fixed = true) && {
+            if (fixed) {
+                sqe_->flags |= IOSQE_FIXED_FILE;
+            }
+            return std::move(*this);
+        }
+
+        // the completion is a wakeup by another fiber, e.g. a futex wait, the fiber runs next on its processor
+        [[nodiscard("need to call await")]]
+        UringOp&& handoff() && {
+            op_data_.handoff_ = true;
+            return std::move(*this);
+        }
+
+        // the next SQE only starts once this one completed in full, a short or failed one cancels it (-ECANCELED)
+        [[nodiscard("need to call await")]]
+        UringOp&& link() && {
+            sqe_->flags |= IOSQE_IO_LINK;
+            return std::move(*this);
+        }
+
+        [[nodiscard("need to call await")]]
+        UringOp&& prep_nop() && {
+            io_uring_prep_nop(sqe_);
+            spdlog::debug("{}", __PRETTY_FUNCTION__);
+            return std::move(*this);
+        }
+
         [[nodiscard("need to call await")]]
         UringOp&& prep_openat(int dirfd, char const* path, int flags, mode_t mode) && {
             io_uring_prep_openat(sqe_, dirfd, path, flags, mode);
@@ -86,6 +149,13 @@ namespace sylar {
             return std::move(*this);
         }
 
+        [[nodiscard("need to call await")]]
+        UringOp&& prep_openat_direct(int dirfd, char const* path, int flags, mode_t mode, unsigned int file_index) && {
+            io_uring_prep_openat_direct(sqe_, dirfd, path, flags, mode, file_index);
+            spdlog::debug("{}", __PRETTY_FUNCTION__);
+            return std::move(*this);
+        }
+
         [[nodiscard("need to call await")]]
         UringOp&& prep_socket(int domain, int type, int protocol, unsigned int flags = 0) && {
             io_uring_prep_socket(sqe_, domain, type, protocol, flags);
@@ -100,6 +170,14 @@ namespace sylar {
             return std::move(*this);
         }
 
+        [[nodiscard("need to call await")]]
+        UringOp&& prep_accept_direct(int fd, struct sockaddr* addr, socklen_t* addrlen, int flags,
+                                     unsigned int file_index) && {
+            io_uring_prep_accept_direct(sqe_, fd, addr, addrlen, flags, file_index);
+            spdlog::debug("{}", __PRETTY_FUNCTION__);
+            return std::move(*this);
+        }
+
         [[nodiscard("need to call await")]]
         UringOp&& prep_connect(int fd, const struct sockaddr* addr, socklen_t addrlen) && {
             io_uring_prep_connect(sqe_, fd, addr, addrlen);
@@ -122,6 +200,36 @@ namespace sylar {
             return std::move(*this);
         }
 
+        [[nodiscard("need to call await")]]
+        UringOp&& prep_readv(int fd, const struct iovec* iovecs, unsigned int nr_vecs,
+                             std::uint64_t offset = static_cast<uint64_t>(-1)) && {
+            io_uring_prep_readv(sqe_, fd, iovecs, nr_vecs, offset);
+            spdlog::debug("{}", __PRETTY_FUNCTION__);
+            return std::move(*this);
+        }
+
+        [[nodiscard("need to call await")]]
+        UringOp&& prep_writev(int fd, const struct iovec* iovecs, unsigned int nr_vecs,
+                              std::uint64_t offset = static_cast<uint64_t>(-1)) && {
+            io_uring_prep_writev(sqe_, fd, iovecs, nr_vecs, offset);
+            spdlog::debug("{}", __PRETTY_FUNCTION__);
+            return std::move(*this);
+        }
+
+        [[nodiscard("need to call await")]]
+        UringOp&& prep_recvmsg(int fd, struct msghdr* msg, unsigned int flags) && {
+            io_uring_prep_recvmsg(sqe_, fd, msg, flags);
+            spdlog::debug("{}", __PRETTY_FUNCTION__);
+            return std::move(*this);
+        }
+
+        [[nodiscard("need to call await")]]
+        UringOp&& prep_sendmsg(int fd, const struct msghdr* msg, unsigned int flags) && {
+            io_uring_prep_sendmsg(sqe_, fd, msg, flags);
+            spdlog::debug("{}", __PRETTY_FUNCTION__);
+            return std::move(*this);
+        }
+
         [[nodiscard("need to call await")]]
         UringOp&& prep_recv(int fd, void* buf, size_t len, int flags) && {
             io_uring_prep_recv(sqe_, fd, buf, len, flags);
@@ -136,6 +244,23 @@ namespace sylar {
             return std::move(*this);
         }
 
+        // completes once the kernel is done with buf, after the notification CQE
+        [[nodiscard("need to call await")]]
+        UringOp&& prep_send_zc(int fd, const void* buf, size_t len, int flags, unsigned int zc_flags = 0) && {
+            io_uring_prep_send_zc(sqe_, fd, buf, len, flags, zc_flags);
+            spdlog::debug("{}", __PRETTY_FUNCTION__);
+            return std::move(*this);
+        }
+
+        // one of fd_in and fd_out must be a pipe, a registered fd_in is flagged by SPLICE_F_FD_IN_FIXED
+        [[nodiscard("need to call await")]]
+        UringOp&& prep_splice(int fd_in, int64_t off_in, int fd_out, int64_t off_out, unsigned int nbytes,
+                              unsigned int splice_flags) && {
+            io_uring_prep_splice(sqe_, fd_in, off_in, fd_out, off_out, nbytes, splice_flags);
+            spdlog::debug("{}", __PRETTY_FUNCTION__);
+            return std::move(*this);
+        }
+
         [[nodiscard("need to call await")]]
         UringOp&& prep_close(int fd) && {
             io_uring_prep_close(sqe_, fd);
@@ -143,6 +268,34 @@ namespace sylar {
             return std::move(*this);
         }
 
+        [[nodiscard("need to call await")]]
+        UringOp&& prep_close_direct(unsigned int file_index) && {
+            io_uring_prep_close_direct(sqe_, file_index);
+            spdlog::debug("{}", __PRETTY_FUNCTION__);
+            return std::move(*this);
+        }
+
+        [[nodiscard("need to call await")]]
+        UringOp&& prep_files_update(int* fds, unsigned int nr_fds, int offset) && {
+            io_uring_prep_files_update(sqe_, fds, nr_fds, offset);
+            spdlog::debug("{}", __PRETTY_FUNCTION__);
+            return std::move(*this);
+        }
+
+        [[nodiscard("need to call await")]]
+        UringOp&& prep_fixed_fd_install(int file_index, unsigned int flags) && {
+            io_uring_prep_fixed_fd_install(sqe_, file_index, flags);
+            spdlog::debug("{}", __PRETTY_FUNCTION__);
+            return std::move(*this);
+        }
+
+        [[nodiscard("need to call await")]]
+        UringOp&& prep_cancel64(uint64_t user_data, int flags) && {
+            io_uring_prep_cancel64(sqe_, user_data, flags);
+            spdlog::debug("{}", __PRETTY_FUNCTION__);
+            return std::move(*this);
+        }
+
         [[nodiscard("need to call await")]]
         UringOp&& prep_link_timeout(struct __kernel_timespec* ts, unsigned int flags) && {
             io_uring_prep_link_timeout(sqe_, ts, flags);
@@ -51,7 +51,8 @@ namespace sylar {
     void sleepFor(std::chrono::system_clock::duration duration) {
         auto* context = Processor::getProcessor();
         if (context) {
-            context->addTimer(duration, [fiber = Fiber::getCurrentFiber()]() { IOContext::spawn(fiber); });
+            // back on its home processor if it has one, otherwise it stays on the processor of the timer
+            context->addTimer(duration, [fiber = Fiber::getCurrentFiber()]() { Processor::ready(fiber); });
             Fiber::yield();
         } else {
             std::this_thread::sleep_for(duration);
@@ -1,12 +1,32 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <liburing.h>
+#include <random>
 #include <source_location>
 
 namespace sylar {
     void schedSetThreadAffinity(std::size_t cpu);
 
+    // hint the CPU that we are spinning
+    inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    // xorshift64*, one state per thread, e.g. to pick steal victims
+    inline uint64_t fastRandom() {
+        static thread_local uint64_t state = (uint64_t{std::random_device{}()} << 32) | 1;
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
     template <class Rep, class Period>
     struct __kernel_timespec durationToKernelTimespec(std::chrono::duration<Rep, Period> dur) {
         struct __kernel_timespec ts{};
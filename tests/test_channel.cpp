@@ -0,0 +1,88 @@
+#include "io_context.h"
+#include "synchronization/channel.h"
+#include "synchronization/wait_group.h"
+
+#include <chrono>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+// an unbuffered send waits for the receive
+void test_unbuffered() {
+    Channel<std::string> channel;
+    WaitGroup group;
+    group.add();
+    IOContext::spawn([&]() {
+        for (int i = 0; i < 3; i++) {
+            channel.send(fmt::format("message {}", i));
+            spdlog::info("sent {}", i);
+        }
+        channel.close();
+        group.done();
+    });
+    while (auto message = channel.recv()) {
+        spdlog::info("received {}", *message);
+    }
+    group.wait();
+    spdlog::info("closed, send returns {}", channel.send("late"));
+}
+
+// a buffered channel drains after close
+void test_buffered() {
+    Channel<int> channel(4);
+    for (int i = 0; i < 4; i++) {
+        channel.send(i);
+    }
+    int extra = 4;
+    spdlog::info("full: trySend {}, size {}", channel.trySend(extra), channel.size());
+    channel.close();
+    int sum = 0;
+    while (auto value = channel.recv()) {
+        sum += *value;
+    }
+    spdlog::info("drained sum {}", sum);
+}
+
+// select between a slow and a fast producer, then time out once both are quiet
+void test_select() {
+    Channel<int> fast(8);
+    Channel<int> slow;
+    WaitGroup group;
+    group.add();
+    IOContext::spawn([&]() {
+        for (int i = 0; i < 5; i++) {
+            fast.send(i);
+        }
+        slow.send(100);
+    });
+    IOContext::spawn([&]() {
+        while (true) {
+            std::optional<int> from_fast;
+            std::optional<int> from_slow;
+            SelectCase cases[] = {fast.recvCase(from_fast), slow.recvCase(from_slow)};
+            auto index = select(cases, std::chrono::milliseconds(200));
+            if (index == 0) {
+                spdlog::info("fast {}", *from_fast);
+            } else if (index == 1) {
+                spdlog::info("slow {}", *from_slow);
+            } else {
+                spdlog::info("timeout");
+                break;
+            }
+        }
+        group.done();
+    });
+    group.wait();
+}
+
+int main() {
+    IOContext context;
+    context.execute();
+
+    // main is off the runtime, its waits fall back to a kernel futex
+    test_unbuffered();
+    test_buffered();
+    test_select();
+}
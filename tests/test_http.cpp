@@ -0,0 +1,125 @@
+#include "http/server.h"
+#include "io_context.h"
+#include "stream/stream.h"
+#include "util.h"
+
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+void handle(http::Request const& request, http::ResponseWriter& writer) {
+    spdlog::debug("{} {}", request.method, request.target);
+    if (request.path() == "/") {
+        writer.send(200, "Hello, world!", "text/html");
+    } else if (request.path() == "/echo") {
+        writer.sendRef(200, request.body, request.headers.get("Content-Type").value_or("text/plain"));
+    } else if (request.path() == "/headers") {
+        std::string body;
+        for (auto const& header : request.headers) {
+            body.append(header.name).append(": ").append(header.value).append("\n");
+        }
+        writer.send(200, body);
+    } else {
+        writer.send(404, "not found\n");
+    }
+}
+
+// hands the input out in the given chunks, lent or copied. A lent chunk is scribbled over once it is given back, so
+// a stream still reading it sees garbage.
+struct ChunkStream : Stream {
+    ChunkStream(std::vector<std::string> chunks, bool lend) : chunks_(std::move(chunks)), lend_(lend) {}
+
+    std::optional<std::span<char const>> raw_borrow() override {
+        if (!lend_) {
+            return std::nullopt;
+        }
+        if (next_ > 0) {
+            chunks_[next_ - 1].assign(chunks_[next_ - 1].size(), '#');
+        }
+        if (next_ == chunks_.size()) {
+            return std::span<char const>();
+        }
+        return std::span<char const>(chunks_[next_++]);
+    }
+
+    std::size_t raw_read(std::span<char> buffer) override {
+        if (next_ == chunks_.size()) {
+            return 0;
+        }
+        auto& chunk = chunks_[next_];
+        auto n = std::min(buffer.size(), chunk.size());
+        std::copy_n(chunk.begin(), n, buffer.begin());
+        chunk.erase(0, n);
+        if (chunk.empty()) {
+            next_++;
+        }
+        return n;
+    }
+
+    std::vector<std::string> chunks_;
+    std::size_t next_{};
+    bool lend_;
+};
+
+// the requests read from the stream the way serve_connection does, as "method target body"
+std::vector<std::string> parse_all(BorrowedStream& stream) {
+    http::RequestParser parser;
+    http::Request request;
+    std::vector<std::string> requests;
+    try {
+        while (true) {
+            auto buffer = stream.peek();
+            auto status = buffer.empty() ? http::ParseStatus::Incomplete : parser.parse(buffer, request);
+            assertThat(status != http::ParseStatus::Error, "parse error");
+            if (status == http::ParseStatus::Complete) {
+                requests.push_back(fmt::format("{} {} {}", request.method, request.target, request.body));
+                stream.ingore(parser.consumed());
+                parser.reset();
+                continue;
+            }
+            stream.fillmore();
+        }
+    } catch (Stream::EOFException&) {
+        // the end of the input
+    }
+    return requests;
+}
+
+// requests split across reads, in the middle of the empty line ending the head and of the body, and pipelined ones
+// sharing a read
+void test_parser() {
+    std::vector<std::string> const chunks = {
+        "GET /a HTTP/1.1\r\nHost: x\r\n\r",
+        "\nPOST /echo HTTP/1.1\r\nContent-Length: 5\r\n\r\nhel",
+        "lo",
+        "GET /b HTTP/1.1\r\n\r\nGET /c HTTP/1.1\r\n\r\nGET /d HTTP/1.1\r\n",
+        "\r\n",
+    };
+    std::vector<std::string> const expected = {"GET /a ", "POST /echo hello", "GET /b ", "GET /c ", "GET /d "};
+    for (bool lend : {true, false}) {
+        ChunkStream raw(chunks, lend);
+        BorrowedStream stream(&raw);
+        auto requests = parse_all(stream);
+        assertThat(requests == expected, "split or pipelined requests");
+    }
+    spdlog::info("parser: {} split and pipelined requests", expected.size());
+}
+
+void test_http() {
+    http::serve(*AddressResolver().host("127.0.0.1").port(8080).resolve_one(), handle);
+    spdlog::info("Listening on http://127.0.0.1:8080/");
+}
+
+int main() {
+    // spdlog::set_level(spdlog::level::debug);
+    test_parser();
+    sylar::IOContext scheduler;
+    scheduler.spawn(test_http);
+    scheduler.execute();
+}
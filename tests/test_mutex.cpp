@@ -1,10 +1,14 @@
 #include "io_context.h"
 #include "synchronization/mutex.h"
+#include "synchronization/shared_mutex.h"
+#include "synchronization/wait_group.h"
 #include "util.h"
 
+#include <atomic>
 #include <chrono>
 
-#include <latch>
+#include <mutex>
+#include <shared_mutex>
 #include <spdlog/common.h>
 #include <spdlog/pattern_formatter.h>
 #include <spdlog/spdlog.h>
@@ -40,48 +44,96 @@ void test_sem() {
     IOContext::spawn([consumer]() { consumer(2); });
 }
 
-// run in main thread
-void test_mutex() {
-    const ptrdiff_t nr_task = 10;
-    {
-        std::latch finish(nr_task);
+// Contention over 2 to 64 fibers spread over the processors, each critical section is an increment. With
+// with_thread the main thread contends as well, its waits go through the kernel futex fallback.
+void test_mutex(int nr_fibers, bool with_thread) {
+    constexpr long NR_LOCKS = 1000000;
+    long per_worker = NR_LOCKS / (nr_fibers + (with_thread ? 1 : 0));
 
-        long sum{};
-
-        auto task = [&]() {
-            for (int i = 0; i < 1000000; i++) {
-                sum++;
-            }
-            finish.count_down();
-        };
-        for (int i = 0; i < nr_task; i++) {
-            IOContext::spawn(task);
+    Mutex mutex;
+    long sum{};
+    auto work = [&]() {
+        for (long i = 0; i < per_worker; i++) {
+            mutex.lock();
+            sum++;
+            mutex.unlock();
         }
-        finish.wait();
+    };
 
-        spdlog::info("sum without mutex: {}", sum);
+    Latch finish(nr_fibers);
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < nr_fibers; i++) {
+        IOContext::spawn([&]() {
+            work();
+            finish.count_down();
+        });
     }
-    {
-        std::latch finish(nr_task);
+    if (with_thread) {
+        work();
+    }
+    finish.wait();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
 
-        long sum{};
+    auto expected = per_worker * (nr_fibers + (with_thread ? 1 : 0));
+    spdlog::info("{:>2} fibers{}: {:6.1f} ns per lock, sum {} {}", nr_fibers, with_thread ? " + thread" : "         ",
+                 elapsed.count() / static_cast<double>(expected), sum, sum == expected ? "ok" : "MISMATCH");
+}
 
-        Mutex mutex;
-        auto task = [&]() {
-            for (int i = 0; i < 1000000; i++) {
-                mutex.lock();
-                sum++;
-                mutex.unlock();
+// readers never see a half updated pair
+void test_shared_mutex() {
+    SharedMutex mutex;
+    long a{};
+    long b{};
+    std::atomic<long> torn{0};
+    WaitGroup group;
+    for (int i = 0; i < 16; i++) {
+        group.add();
+        IOContext::spawn([&, writer = i % 8 == 0]() {
+            for (int j = 0; j < 100000; j++) {
+                if (writer) {
+                    std::lock_guard<SharedMutex> lock(mutex);
+                    a++;
+                    b++;
+                } else {
+                    std::shared_lock<SharedMutex> lock(mutex);
+                    if (a != b) {
+                        torn++;
+                    }
+                }
             }
-            finish.count_down();
-        };
-        for (int i = 0; i < nr_task; i++) {
-            IOContext::spawn(task);
-        }
-        finish.wait();
+            group.done();
+        });
+    }
+    group.wait();
+    spdlog::info("shared mutex: a {} b {}, {} torn reads", a, b, torn.load());
+}
 
-        spdlog::info("sum with mutex: {}", sum);
+// the completion of each phase sees every fiber arrived
+void test_barrier() {
+    constexpr int NR_FIBERS = 8;
+    constexpr int NR_PHASES = 1000;
+    std::atomic<int> arrived{0};
+    int phases{};
+    int mismatches{};
+    Barrier barrier(NR_FIBERS, [&]() {
+        phases++;
+        if (arrived.load() != phases * NR_FIBERS) {
+            mismatches++;
+        }
+    });
+    WaitGroup group;
+    group.add(NR_FIBERS);
+    for (int i = 0; i < NR_FIBERS; i++) {
+        IOContext::spawn([&]() {
+            for (int j = 0; j < NR_PHASES; j++) {
+                arrived++;
+                barrier.arrive_and_wait();
+            }
+            group.done();
+        });
     }
+    group.wait();
+    spdlog::info("barrier: {} phases, {} mismatches", phases, mismatches);
 }
 
 int main() {
@@ -89,5 +141,10 @@ int main() {
     IOContext context;
     context.execute();
 
-    test_mutex();
+    for (int nr_fibers = 2; nr_fibers <= 64; nr_fibers *= 2) {
+        test_mutex(nr_fibers, false);
+    }
+    test_mutex(8, true);
+    test_shared_mutex();
+    test_barrier();
 }
@@ -1,5 +1,6 @@
 #include "file/socket.h"
 #include "io_context.h"
+#include "metrics.h"
 
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -14,8 +15,7 @@ const std::string response = "HTTP/1.1 200 OK\r\n"
                              "\r\n"
                              "Hello, world!";
 
-void handle(int fd) {
-    auto sock = SocketHandle(fd);
+void handle(SocketHandle sock) {
     char buf[256];
     while (true) {
         auto ret = socket_read(sock, buf);
@@ -33,12 +33,12 @@ void handle(int fd) {
 void test_socket() {
     spdlog::info("test_socket");
 
-    auto sock = socket_listen(*AddressResolver().host("127.0.0.1").port(8080).resolve_one(), SOMAXCONN);
+    // one listener and accept loop per processor, connections stay on the processor which accepted them
+    socket_listen_sharded(*AddressResolver().host("127.0.0.1").port(8080).resolve_one(), handle);
     spdlog::info("Listening on port 8080...");
-    while (true) {
-        auto client_sock = socket_accept(sock).releaseFile();
-        IOContext::spawn(([client_sock]() { handle(client_sock); }));
-    }
+
+    metrics_serve(*AddressResolver().host("127.0.0.1").port(9090).resolve_one());
+    spdlog::info("Metrics on http://127.0.0.1:9090/metrics");
 }
 
 int main() {
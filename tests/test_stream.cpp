@@ -2,11 +2,47 @@
 #include "stream/socket_stream.h"
 #include "stream/stdio_stream.h"
 #include "stream/stream.h"
+#include "util.h"
+
+#include <string>
+#include <string_view>
 
 #include <spdlog/spdlog.h>
 
 using namespace sylar;
 
+// collects what is written, one write or gather write at a time
+struct StringStream : Stream {
+    std::size_t raw_write(std::span<char const> buffer) override {
+        written_.append(buffer.data(), buffer.size());
+        return buffer.size();
+    }
+
+    std::size_t raw_writev(std::span<struct iovec const> iov) override {
+        std::size_t len = 0;
+        for (auto const& segment : iov) {
+            written_.append(static_cast<char const*>(segment.iov_base), segment.iov_len);
+            len += segment.iov_len;
+        }
+        return len;
+    }
+
+    std::string written_;
+};
+
+// a reference as the very first output, before the output buffer exists
+void test_put_ref() {
+    StringStream raw;
+    BorrowedStream stream(&raw);
+    stream.put_ref(std::string_view("ref "));
+    stream.put('c');
+    stream.put(std::string_view(" span"));
+    stream.put_ref(std::string_view(" ref"));
+    stream.flush();
+    assertThat(raw.written_ == "ref c span ref", "put_ref then put");
+    spdlog::info("put_ref: {}", raw.written_);
+}
+
 void test_stream() {
     while (true) {
         std::string line = stdio().getline('\n');
@@ -40,6 +76,7 @@ void test_socket_stream() {
 
 int main() {
     spdlog::set_level(spdlog::level::debug);
+    test_put_ref();
 
     IOContext scheduler;
     scheduler.spawn(test_socket_stream);
@@ -0,0 +1,88 @@
+#include "file/file.h"
+#include "io_context.h"
+#include "synchronization/wait_group.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include <spdlog/spdlog.h>
+
+using namespace sylar;
+
+std::size_t nr_p = 8;
+int nr_readers = 64;
+int nr_rounds = 200;
+
+// Fibers keep moving onto the owner of a registered file through switchTo while the owner is busy and the others
+// are idle and steal from it. Every read must run on the owner, a fiber stolen on the way submits the slot on a ring
+// which doesn't have it.
+void test_switch_steal() {
+    auto path = std::filesystem::temp_directory_path() / "sylar_test_switch";
+    std::ofstream(path) << "registered";
+
+    std::atomic<int> reads{0};
+    std::atomic<int> errors{0};
+    WaitGroup group;
+    group.add();
+    IOContext::spawnOn(0, [&]() {
+        auto file = file_open(path, OpenMode::Read);
+        spdlog::info("file registered: {}, plain fd {}", file.isFixed(), file.fileNo());
+
+        // busy fibers in the run queue of the owner, for the idle processors to steal along with the readers
+        std::atomic<bool> done{false};
+        WaitGroup busy;
+        for (std::size_t i = 0; i < nr_p; i++) {
+            busy.add();
+            IOContext::spawn([&]() {
+                while (!done.load()) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                    Fiber::yield(Fiber::READY);
+                }
+                busy.done();
+            });
+        }
+
+        WaitGroup readers;
+        for (int i = 0; i < nr_readers; i++) {
+            readers.add();
+            IOContext::spawnOn(1 + static_cast<uint64_t>(i) % (nr_p - 1), [&, i]() {
+                Processor::unpin();
+                char buf[16];
+                for (int round = 0; round < nr_rounds; round++) {
+                    try {
+                        file_read(file, buf, 0);
+                        reads++;
+                        if (Processor::getProcessorID() != file.owner()) {
+                            errors++;
+                        }
+                    } catch (std::system_error& ex) {
+                        spdlog::error("reader {}: {}", i, ex.what());
+                        errors++;
+                    }
+                    // off the owner again, the next read moves back
+                    Processor::switchTo(1 + static_cast<uint64_t>(i + round) % (nr_p - 1));
+                }
+                readers.done();
+            });
+        }
+        readers.wait();
+        done = true;
+        busy.wait();
+        file_close(std::move(file));
+        group.done();
+    });
+    group.wait();
+    std::filesystem::remove(path);
+    spdlog::info("{} reads, {} errors", reads.load(), errors.load());
+}
+
+int main() {
+    IOContext scheduler(IOContextOptions{.thread_count = nr_p, .fixed_files = 64});
+    scheduler.execute();
+
+    test_switch_steal();
+    scheduler.stop();
+}